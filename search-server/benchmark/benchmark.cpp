@@ -0,0 +1,579 @@
+// Benchmarks of SearchServer workloads over generated corpora.
+// Prints one JSON object per line and benchmark:
+//   {"benchmark": "find_top/seq", "documents": 10000, "vocabulary": 1000, "query_words": 3,
+//    "calls": 1000, "items": 1000, "p50_us": 12.5, "p99_us": 40.1, "throughput": 70000, "peak_rss_kb": 51200}
+// p50/p99 are per call, throughput is items per second, peak RSS is of the whole process so far.
+// Checks compare the results of alternative evaluations before they are timed, exactly
+// or, for float scores, within epsilon of the relevance:
+//   {"check": "find_top/wand", "documents": 10000, "vocabulary": 1000, "query_words": 3, "calls": 1000, "mismatches": 0}
+// The exit code is 1 if any check has mismatches.
+//
+// Build and run from search-server/:
+//   cmake -S . -B build && cmake --build build --target search_benchmark && build/search_benchmark --quick
+// or configure with -DBENCHMARK_ARGS=--quick and build the run_benchmark target
+// Options: --quick for a small smoke run, --filter=<text> to run benchmarks whose name contains it
+#include "search_server.h"
+#include "index_snapshot.h"
+#include "log_duration.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+struct Workload {
+    int document_count;
+    int vocabulary_size;
+    int document_words;
+    int query_words;
+};
+
+struct Corpus {
+    vector<string> dictionary;
+    vector<string> documents;
+    vector<string> queries;
+};
+
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(uniform_int_distribution('a', 'z')(generator));
+    }
+    return word;
+}
+
+// Zipf-like word choice, so that posting list lengths look like those of real text
+string GenerateText(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            text.push_back('-');
+        }
+        const double rank = pow(dictionary.size(), uniform_real_distribution<>(0, 1)(generator)) - 1;
+        text += dictionary[min(static_cast<size_t>(rank), dictionary.size() - 1)];
+    }
+    return text;
+}
+
+Corpus GenerateCorpus(const Workload& workload) {
+    mt19937 generator(workload.document_count ^ workload.vocabulary_size);
+    Corpus corpus;
+    for (int i = 0; i < workload.vocabulary_size; ++i) {
+        corpus.dictionary.push_back(GenerateWord(generator, 10));
+    }
+    sort(corpus.dictionary.begin(), corpus.dictionary.end());
+    corpus.dictionary.erase(unique(corpus.dictionary.begin(), corpus.dictionary.end()), corpus.dictionary.end());
+    shuffle(corpus.dictionary.begin(), corpus.dictionary.end(), generator);
+    for (int i = 0; i < workload.document_count; ++i) {
+        corpus.documents.push_back(GenerateText(generator, corpus.dictionary, workload.document_words));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        corpus.queries.push_back(GenerateText(generator, corpus.dictionary, workload.query_words, 0.1));
+    }
+    return corpus;
+}
+
+size_t GetPeakRssKb() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+class Benchmark {
+public:
+    Benchmark(const Workload& workload, string filter)
+        : workload_(workload)
+        , filter_(move(filter)) {
+    }
+
+    bool IsEnabled(string_view name) const {
+        return name.find(filter_) != string_view::npos;
+    }
+
+    // Calls f(i) for i in [0, calls), each call counting as items_per_call items
+    template <typename Function>
+    void Run(string_view name, size_t calls, size_t items_per_call, Function f) {
+        if (!IsEnabled(name) || calls == 0) {
+            return;
+        }
+        vector<double> latencies(calls);
+        LogDuration total(name, null_stream_);
+        for (size_t i = 0; i < calls; ++i) {
+            const auto start = LogDuration::Clock::now();
+            f(i);
+            latencies[i] = chrono::duration<double, micro>(LogDuration::Clock::now() - start).count();
+        }
+        const double seconds = chrono::duration<double>(total.Elapsed()).count();
+        Report(name, latencies, calls * items_per_call, seconds);
+    }
+
+    // Calls f(i) for i in [0, calls), f returns whether the results agree
+    template <typename Function>
+    void Check(string_view name, size_t calls, Function f) {
+        if (!IsEnabled(name) || calls == 0) {
+            return;
+        }
+        size_t mismatches = 0;
+        for (size_t i = 0; i < calls; ++i) {
+            mismatches += !f(i);
+        }
+        failed_ = failed_ || mismatches > 0;
+        cout << "{\"check\": \"" << name << "\", \"documents\": " << workload_.document_count
+             << ", \"vocabulary\": " << workload_.vocabulary_size << ", \"query_words\": " << workload_.query_words
+             << ", \"calls\": " << calls << ", \"mismatches\": " << mismatches << "}" << endl;
+    }
+
+    bool failed() const {
+        return failed_;
+    }
+
+private:
+    Workload workload_;
+    string filter_;
+    bool failed_ = false;
+    ostringstream null_stream_;
+
+    static double Percentile(vector<double>& values, double fraction) {
+        const size_t index = min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+        nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+    void Report(string_view name, vector<double>& latencies, size_t items, double seconds) {
+        const size_t calls = latencies.size();
+        const double p50 = Percentile(latencies, 0.5);
+        const double p99 = Percentile(latencies, 0.99);
+        cout << "{\"benchmark\": \"" << name << "\", \"documents\": " << workload_.document_count
+             << ", \"vocabulary\": " << workload_.vocabulary_size << ", \"query_words\": " << workload_.query_words
+             << ", \"calls\": " << calls << ", \"items\": " << items << ", \"p50_us\": " << p50 << ", \"p99_us\": " << p99
+             << ", \"throughput\": " << (seconds > 0 ? items / seconds : 0.0) << ", \"peak_rss_kb\": " << GetPeakRssKb() << "}"
+             << endl;
+    }
+};
+
+bool IsSameResult(const vector<Document>& lhs, const vector<Document>& rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& lhs, const Document& rhs) {
+        return lhs.id == rhs.id && lhs.relevance == rhs.relevance && lhs.rating == rhs.rating;
+    });
+}
+
+bool IsClose(double lhs, double rhs) {
+    return abs(lhs - rhs) <= epsilon * max(1.0, abs(rhs));
+}
+
+// Relevance agrees within epsilon of its value at every rank. Documents may only trade
+// places with ones that close, possibly one just outside the top of expected
+bool IsCloseResult(const vector<Document>& actual, const vector<Document>& expected) {
+    if (actual.size() != expected.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < actual.size(); ++i) {
+        if (!IsClose(actual[i].relevance, expected[i].relevance)) {
+            return false;
+        }
+        const auto it = find_if(expected.begin(), expected.end(), [&](const Document& document) {
+            return document.id == actual[i].id;
+        });
+        const double expected_relevance = it != expected.end() ? it->relevance : expected.back().relevance;
+        if (!IsClose(actual[i].relevance, expected_relevance)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AddCorpus(SearchServer& search_server, const Corpus& corpus, size_t count) {
+    vector<DocumentInput> documents;
+    for (size_t i = 0; i < count; ++i) {
+        documents.push_back({ static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 } });
+    }
+    search_server.AddDocuments(execution::par, documents);
+}
+
+vector<char> ReadFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return vector<char>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+void WriteFile(const string& path, const vector<char>& data) {
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(data.data(), data.size());
+}
+
+// Flips a bit in the first block of every posting list of a snapshot written by SaveIndex
+void CorruptPostings(vector<char>& snapshot) {
+    index_snapshot::FileHeader header;
+    memcpy(&header, snapshot.data(), sizeof(header));
+    for (uint64_t term = 0; term < header.term_count; ++term) {
+        index_snapshot::PostingRecord record;
+        memcpy(&record, snapshot.data() + header.postings.offset + term * sizeof(record), sizeof(record));
+        if (record.size > 0) {
+            snapshot[record.blocks_offset] ^= 1;
+        }
+    }
+}
+
+template <typename Function>
+bool ThrowsRuntimeError(Function f) {
+    try {
+        f();
+    } catch (const runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Returns false if a check found mismatches
+bool RunWorkload(const Workload& workload, const string& filter) {
+    const Corpus corpus = GenerateCorpus(workload);
+    const string& stop_words = corpus.dictionary[0];
+    const auto& queries = corpus.queries;
+    const size_t document_count = corpus.documents.size();
+    Benchmark benchmark(workload, filter);
+
+    SearchServer search_server(stop_words);
+    benchmark.Run("build/add_document", document_count, 1, [&](size_t i) {
+        search_server.AddDocument(i, corpus.documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    });
+    if (search_server.GetDocumentCount() == 0) {
+        AddCorpus(search_server, corpus, document_count);
+    }
+    if (benchmark.IsEnabled("build/add_documents_par")) {
+        SearchServer single_server(stop_words);
+        for (size_t i = 0; i < document_count; ++i) {
+            single_server.AddDocument(i, corpus.documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+        SearchServer bulk_server(stop_words);
+        AddCorpus(bulk_server, corpus, document_count);
+        benchmark.Check("build/add_documents_par", queries.size(), [&](size_t i) {
+            return IsSameResult(bulk_server.FindTopDocuments(execution::seq, queries[i]),
+                single_server.FindTopDocuments(execution::seq, queries[i]));
+        });
+    }
+    benchmark.Run("build/add_documents_par", 1, document_count, [&](size_t) {
+        SearchServer bulk_server(stop_words);
+        AddCorpus(bulk_server, corpus, document_count);
+    });
+    if (benchmark.IsEnabled("build/add_document_compressed")) {
+        // Appending to sealed posting lists
+        SearchServer compressed_server = search_server;
+        compressed_server.CompressIndex();
+        benchmark.Run("build/add_document_compressed", document_count, 1, [&](size_t i) {
+            compressed_server.AddDocument(document_count + i, corpus.documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        });
+    }
+
+    benchmark.Run("find_top/seq", queries.size(), 1, [&](size_t i) {
+        search_server.FindTopDocuments(execution::seq, queries[i]);
+    });
+    benchmark.Check("find_top/par", queries.size(), [&](size_t i) {
+        return IsSameResult(search_server.FindTopDocuments(execution::par, queries[i]),
+            search_server.FindTopDocuments(execution::seq, queries[i]));
+    });
+    benchmark.Run("find_top/par", queries.size(), 1, [&](size_t i) {
+        search_server.FindTopDocuments(execution::par, queries[i]);
+    });
+    benchmark.Check("find_top/wand", queries.size(), [&](size_t i) {
+        return IsSameResult(search_server.FindTopDocuments(search_policy::wand, queries[i]),
+            search_server.FindTopDocuments(execution::seq, queries[i]));
+    });
+    benchmark.Run("find_top/wand", queries.size(), 1, [&](size_t i) {
+        search_server.FindTopDocuments(search_policy::wand, queries[i]);
+    });
+
+    if (benchmark.IsEnabled("find_top/scalar")) {
+        // The other runs use the best kernel the CPU supports, which must add up the same scores
+        const ScoreKernel kernel = GetScoreKernel();
+        vector<vector<Document>> kernel_results[2];
+        for (ScorePrecision precision : { ScorePrecision::DOUBLE, ScorePrecision::FLOAT }) {
+            search_server.SetScorePrecision(precision);
+            for (const string& query : queries) {
+                kernel_results[static_cast<int>(precision)].push_back(search_server.FindTopDocuments(execution::seq, query));
+            }
+        }
+        SetScoreKernel(ScoreKernel::SCALAR);
+        for (ScorePrecision precision : { ScorePrecision::DOUBLE, ScorePrecision::FLOAT }) {
+            search_server.SetScorePrecision(precision);
+            benchmark.Check(precision == ScorePrecision::DOUBLE ? "find_top/scalar" : "find_top/scalar_float", queries.size(), [&](size_t i) {
+                return IsSameResult(search_server.FindTopDocuments(execution::seq, queries[i]), kernel_results[static_cast<int>(precision)][i]);
+            });
+        }
+        search_server.SetScorePrecision(ScorePrecision::DOUBLE);
+        benchmark.Run("find_top/scalar", queries.size(), 1, [&](size_t i) {
+            search_server.FindTopDocuments(execution::seq, queries[i]);
+        });
+        SetScoreKernel(kernel);
+    }
+    if (benchmark.IsEnabled("find_top/float")) {
+        vector<vector<Document>> double_results;
+        for (const string& query : queries) {
+            double_results.push_back(search_server.FindTopDocuments(execution::seq, query));
+        }
+        search_server.SetScorePrecision(ScorePrecision::FLOAT);
+        benchmark.Check("find_top/float", queries.size(), [&](size_t i) {
+            return IsCloseResult(search_server.FindTopDocuments(execution::seq, queries[i]), double_results[i]);
+        });
+        benchmark.Run("find_top/float", queries.size(), 1, [&](size_t i) {
+            search_server.FindTopDocuments(execution::seq, queries[i]);
+        });
+        search_server.SetScorePrecision(ScorePrecision::DOUBLE);
+    }
+
+    if (benchmark.IsEnabled("find_top/cached")) {
+        // A few queries over and over, every tenth call after an update that changes
+        // their results, so a stale cache entry would show
+        SearchServer cached_server = search_server;
+        SearchServer uncached_server = search_server;
+        cached_server.SetQueryCacheCapacity(queries.size());
+        const size_t hot_count = 10;
+        benchmark.Check("find_top/cached", queries.size(), [&](size_t i) {
+            const string& query = queries[i % hot_count];
+            if (i % 10 == 9) {
+                const int step = static_cast<int>(i / 10);
+                if (step % 3 == 0) {
+                    // The query's own words, so the document ranks high
+                    string text = query;
+                    text.erase(remove(text.begin(), text.end(), '-'), text.end());
+                    for (SearchServer* server : { &cached_server, &uncached_server }) {
+                        server->AddDocument(document_count + step, text, DocumentStatus::ACTUAL, { step % 10 });
+                    }
+                } else if (step % 3 == 1) {
+                    const vector<Document> top = uncached_server.FindTopDocuments(execution::seq, query);
+                    if (!top.empty()) {
+                        cached_server.RemoveDocument(top[0].id);
+                        uncached_server.RemoveDocument(top[0].id);
+                    }
+                } else {
+                    cached_server.SetMaxResultDocumentCount(1 + step % 7);
+                    uncached_server.SetMaxResultDocumentCount(1 + step % 7);
+                }
+            }
+            return IsSameResult(cached_server.FindTopDocuments(execution::seq, query),
+                uncached_server.FindTopDocuments(execution::seq, query));
+        });
+
+        // Skewed traffic: a few queries make up most of the calls
+        mt19937 generator(1);
+        vector<size_t> picks(5 * queries.size());
+        for (size_t& pick : picks) {
+            pick = min(queries.size() - 1, static_cast<size_t>(pow(queries.size(), uniform_real_distribution<>(0, 1)(generator))) - 1);
+        }
+        search_server.SetQueryCacheCapacity(queries.size() / 4);
+        benchmark.Run("find_top/cached", picks.size(), 1, [&](size_t i) {
+            search_server.FindTopDocuments(execution::seq, queries[picks[i]]);
+        });
+        search_server.SetQueryCacheCapacity(0);
+    }
+
+    if (benchmark.IsEnabled("find_top/filter_predicate") || benchmark.IsEnabled("find_top/filter")) {
+        // Mixed statuses and ratings, a filter drops BANNED and REMOVED and low ratings
+        SearchServer mixed_server(stop_words);
+        for (size_t i = 0; i < document_count; ++i) {
+            mixed_server.AddDocument(i, corpus.documents[i], static_cast<DocumentStatus>(i % 4), { static_cast<int>(i % 10) });
+        }
+        const auto predicate = [](int, DocumentStatus status, int rating) {
+            return (status == DocumentStatus::ACTUAL || status == DocumentStatus::IRRELEVANT) && rating >= 3;
+        };
+        benchmark.Run("find_top/filter_predicate", queries.size(), 1, [&](size_t i) {
+            mixed_server.FindTopDocuments(execution::seq, queries[i], predicate);
+        });
+        const DocumentFilter filter({ DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT }, 3);
+        benchmark.Check("find_top/filter", queries.size(), [&](size_t i) {
+            return IsSameResult(mixed_server.FindTopDocuments(execution::seq, queries[i], filter),
+                mixed_server.FindTopDocuments(execution::seq, queries[i], predicate));
+        });
+        benchmark.Run("find_top/filter", queries.size(), 1, [&](size_t i) {
+            mixed_server.FindTopDocuments(execution::seq, queries[i], filter);
+        });
+    }
+
+    if (benchmark.IsEnabled("snapshot/")) {
+        const string path = (filesystem::temp_directory_path() / "search_benchmark.idx").string();
+        const string corrupted_path = path + ".corrupted"s;
+        search_server.SaveIndex(path);
+        {
+            vector<char> snapshot = ReadFile(path);
+            CorruptPostings(snapshot);
+            WriteFile(corrupted_path, snapshot);
+        }
+        for (bool build_forward_index : { false, true }) {
+            const SearchServer loaded = SearchServer::LoadIndex(path, build_forward_index);
+            benchmark.Check(build_forward_index ? "snapshot/load_forward_index" : "snapshot/load", queries.size(), [&](size_t i) {
+                return IsSameResult(loaded.FindTopDocuments(execution::seq, queries[i]),
+                    search_server.FindTopDocuments(execution::seq, queries[i]));
+            });
+        }
+        {
+            // Loading does not read the posting lists, using any of them must throw
+            SearchServer corrupted = SearchServer::LoadIndex(corrupted_path);
+            benchmark.Check("snapshot/corrupted_query", queries.size(), [&](size_t i) {
+                // A query without plus words in the index reads no list
+                return ThrowsRuntimeError([&] { corrupted.FindTopDocuments(execution::seq, queries[i]); })
+                    || search_server.FindTopDocuments(execution::seq, queries[i]).empty();
+            });
+            benchmark.Check("snapshot/corrupted_update", min<size_t>(100, document_count), [&](size_t i) {
+                const int document_id = static_cast<int>(document_count + i);
+                const vector<DocumentInput> documents = { { document_id, corpus.documents[i], DocumentStatus::ACTUAL, { 1 } } };
+                return ThrowsRuntimeError([&] { corrupted.AddDocument(document_id, corpus.documents[i], DocumentStatus::ACTUAL, { 1 }); })
+                    && ThrowsRuntimeError([&] { corrupted.AddDocuments(execution::par, documents); })
+                    && ThrowsRuntimeError([&] { corrupted.RemoveDocument(static_cast<int>(i)); })
+                    && corrupted.GetDocumentCount() == search_server.GetDocumentCount();
+            });
+        }
+        filesystem::remove(path);
+        filesystem::remove(corrupted_path);
+    }
+
+    benchmark.Run("match/seq", queries.size(), 1, [&](size_t i) {
+        search_server.MatchDocument(execution::seq, queries[i], i * 7919 % document_count);
+    });
+    benchmark.Run("match/par", queries.size(), 1, [&](size_t i) {
+        search_server.MatchDocument(execution::par, queries[i], i * 7919 % document_count);
+    });
+
+    if (benchmark.IsEnabled("match/all")) {
+        // Highlighting every document for a query
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        benchmark.Run("match/all_loop", 20, document_ids.size(), [&](size_t i) {
+            for (int document_id : document_ids) {
+                search_server.MatchDocument(queries[i], document_id);
+            }
+        });
+        benchmark.Run("match/all_batch", 20, document_ids.size(), [&](size_t i) {
+            search_server.MatchDocuments(execution::par, queries[i], document_ids);
+        });
+    }
+
+    benchmark.Run("process_queries", 5, queries.size(), [&](size_t) {
+        ProcessQueries(search_server, queries);
+    });
+    benchmark.Run("process_queries_joined", 5, queries.size(), [&](size_t) {
+        ProcessQueriesJoined(search_server, queries);
+    });
+
+    const size_t remove_count = min<size_t>(1000, document_count);
+    if (benchmark.IsEnabled("remove/seq")) {
+        SearchServer copy = search_server;
+        benchmark.Run("remove/seq", remove_count, 1, [&](size_t i) {
+            copy.RemoveDocument(execution::seq, i * document_count / remove_count);
+        });
+    }
+    if (benchmark.IsEnabled("remove/par")) {
+        SearchServer copy = search_server;
+        benchmark.Run("remove/par", remove_count, 1, [&](size_t i) {
+            copy.RemoveDocument(execution::par, i * document_count / remove_count);
+        });
+    }
+    if (benchmark.IsEnabled("remove/batch")) {
+        SearchServer copy = search_server;
+        vector<int> document_ids(remove_count);
+        for (size_t i = 0; i < remove_count; ++i) {
+            document_ids[i] = i * document_count / remove_count;
+        }
+        SearchServer batch_copy = search_server;
+        batch_copy.RemoveDocuments(execution::par, document_ids);
+        batch_copy.CompactIndex(execution::par);
+        SearchServer single_copy = search_server;
+        for (int document_id : document_ids) {
+            single_copy.RemoveDocument(document_id);
+        }
+        benchmark.Check("remove/batch", queries.size(), [&](size_t i) {
+            return IsSameResult(batch_copy.FindTopDocuments(execution::seq, queries[i]),
+                single_copy.FindTopDocuments(execution::seq, queries[i]));
+        });
+        benchmark.Run("remove/batch", 1, remove_count, [&](size_t) {
+            copy.RemoveDocuments(execution::par, document_ids);
+            copy.CompactIndex(execution::par);
+        });
+    }
+
+    if (benchmark.IsEnabled("remove_duplicates")) {
+        // Every tenth document repeats an earlier one with its words shuffled
+        SearchServer duplicates_server(stop_words);
+        AddCorpus(duplicates_server, corpus, document_count);
+        for (size_t i = 0; i < document_count / 10; ++i) {
+            vector<string_view> words = SplitIntoWords(corpus.documents[i]);
+            reverse(words.begin(), words.end());
+            string text;
+            for (string_view word : words) {
+                text += word;
+                text += ' ';
+            }
+            duplicates_server.AddDocument(document_count + i, text, DocumentStatus::ACTUAL, {});
+        }
+        benchmark.Run("remove_duplicates", 1, duplicates_server.GetDocumentCount(), [&](size_t) {
+            // RemoveDuplicates reports every duplicate to cout
+            ostringstream removed;
+            auto* const cout_buffer = cout.rdbuf(removed.rdbuf());
+            RemoveDuplicates(duplicates_server);
+            cout.rdbuf(cout_buffer);
+        });
+    }
+    return !benchmark.failed();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    string filter;
+    for (int i = 1; i < argc; ++i) {
+        const string_view arg = argv[i];
+        if (arg == "--quick"sv) {
+            quick = true;
+        } else if (arg.substr(0, 9) == "--filter="sv) {
+            filter = string(arg.substr(9));
+        } else {
+            cerr << "Usage: "s << argv[0] << " [--quick] [--filter=<text>]"s << endl;
+            return 1;
+        }
+    }
+
+    vector<Workload> workloads;
+    if (quick) {
+        workloads = { { 2'000, 1'000, 50, 3 }, { 2'000, 1'000, 50, 20 } };
+    } else {
+        for (int document_count : { 10'000, 50'000 }) {
+            for (int vocabulary_size : { 1'000, 20'000 }) {
+                for (int query_words : { 3, 20, 70 }) {
+                    workloads.push_back({ document_count, vocabulary_size, 70, query_words });
+                }
+            }
+        }
+    }
+    bool passed = true;
+    for (const Workload& workload : workloads) {
+        passed = RunWorkload(workload, filter) && passed;
+    }
+    return passed ? 0 : 1;
+}
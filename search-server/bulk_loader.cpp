@@ -0,0 +1,35 @@
+#include "bulk_loader.h"
+
+BulkLoader::BulkLoader(SearchServer& search_server, size_t batch_size)
+    : search_server_(search_server)
+    , batch_size_(max<size_t>(1, batch_size)) {
+}
+
+void BulkLoader::Add(int document_id, string document, DocumentStatus status, vector<int> ratings) {
+    pending_.push_back({ document_id, move(document), status, move(ratings) });
+    if (pending_.size() >= batch_size_) {
+        Flush();
+    }
+}
+
+size_t BulkLoader::AddLines(istream& input, int first_document_id) {
+    size_t count = 0;
+    string line;
+    while (getline(input, line)) {
+        Add(first_document_id + static_cast<int>(count), move(line), DocumentStatus::ACTUAL, {});
+        ++count;
+    }
+    return count;
+}
+
+void BulkLoader::Flush() {
+    // A rejected batch is dropped as a whole, the loader stays usable
+    vector<PendingDocument> batch;
+    batch.swap(pending_);
+    vector<DocumentInput> documents;
+    documents.reserve(batch.size());
+    for (PendingDocument& document : batch) {
+        documents.push_back({ document.id, document.text, document.status, move(document.ratings) });
+    }
+    search_server_.AddDocuments(execution::par, documents);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "search_server.h"
+#include <istream>
+
+// Feeds documents to SearchServer::AddDocuments in batches, so that a large input
+// is indexed in parallel while only one batch of texts is held in memory
+class BulkLoader {
+public:
+    static constexpr size_t DEFAULT_BATCH_SIZE = 1 << 14;
+
+    explicit BulkLoader(SearchServer& search_server, size_t batch_size = DEFAULT_BATCH_SIZE);
+
+    // Indexing may be delayed until the batch is full or Flush is called
+    void Add(int document_id, string document, DocumentStatus status, vector<int> ratings);
+
+    // Adds every line of the input as an ACTUAL document without ratings, with ids
+    // counting up from first_document_id. Returns the number of lines read
+    size_t AddLines(istream& input, int first_document_id);
+
+    // Indexes the pending documents; must be called once the input is over
+    void Flush();
+
+private:
+    struct PendingDocument {
+        int id;
+        string text;
+        DocumentStatus status;
+        vector<int> ratings;
+    };
+
+    SearchServer& search_server_;
+    size_t batch_size_;
+    vector<PendingDocument> pending_;
+};
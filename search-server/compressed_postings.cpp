@@ -0,0 +1,271 @@
+#include "compressed_postings.h"
+#include <algorithm>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t LANE_COUNT = 4;
+constexpr size_t VALUES_PER_LANE = CompressedPostings::BLOCK_SIZE / LANE_COUNT;
+
+unsigned BitWidth(uint32_t value) {
+    unsigned bits = 0;
+    while (value != 0) {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+// Value i goes to lane i % 4, so each lane holds 32 values in `bits` words
+// and word w of lane l is stored at out[w * 4 + l]
+void Pack(const uint32_t* values, unsigned bits, std::vector<uint32_t>& out) {
+    const size_t first_word = out.size();
+    out.resize(first_word + bits * LANE_COUNT, 0);
+    if (bits == 0) {
+        return;
+    }
+    uint32_t* words = out.data() + first_word;
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+        size_t bit = 0;
+        for (size_t i = 0; i < VALUES_PER_LANE; ++i, bit += bits) {
+            const uint32_t value = values[i * LANE_COUNT + lane];
+            const size_t word = bit / 32;
+            const unsigned shift = bit % 32;
+            words[word * LANE_COUNT + lane] |= value << shift;
+            if (shift + bits > 32) {
+                words[(word + 1) * LANE_COUNT + lane] |= value >> (32 - shift);
+            }
+        }
+    }
+}
+
+#if defined(__SSE2__)
+
+// Values are unpacked with offset_value added to them
+void Unpack(const uint32_t* words, unsigned bits, uint32_t offset_value, uint32_t* values) {
+    const __m128i offset = _mm_set1_epi32(static_cast<int>(offset_value));
+    if (bits == 0) {
+        for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values) + i, offset);
+        }
+        return;
+    }
+    const __m128i mask = _mm_set1_epi32(bits == 32 ? -1 : static_cast<int>((1u << bits) - 1));
+    const __m128i* in = reinterpret_cast<const __m128i*>(words);
+    __m128i current = _mm_loadu_si128(in);
+    size_t word = 0;
+    unsigned shift = 0;
+    for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+        __m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128(shift));
+        shift += bits;
+        if (shift >= 32) {
+            shift -= 32;
+            if (++word < bits) {
+                current = _mm_loadu_si128(in + word);
+                if (shift > 0) {
+                    value = _mm_or_si128(value, _mm_sll_epi32(current, _mm_cvtsi32_si128(bits - shift)));
+                }
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values) + i, _mm_add_epi32(_mm_and_si128(value, mask), offset));
+    }
+}
+
+// Turns deltas into document ids, four at a time
+void PrefixSum(uint32_t* values, uint32_t base) {
+    __m128i previous = _mm_set1_epi32(static_cast<int>(base));
+    for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+        __m128i* ptr = reinterpret_cast<__m128i*>(values) + i;
+        __m128i sum = _mm_loadu_si128(ptr);
+        sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 4));
+        sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 8));
+        sum = _mm_add_epi32(sum, previous);
+        _mm_storeu_si128(ptr, sum);
+        previous = _mm_shuffle_epi32(sum, 0xFF);
+    }
+}
+
+#else
+
+void Unpack(const uint32_t* words, unsigned bits, uint32_t offset_value, uint32_t* values) {
+    if (bits == 0) {
+        std::fill(values, values + CompressedPostings::BLOCK_SIZE, offset_value);
+        return;
+    }
+    const uint32_t mask = bits == 32 ? ~0u : (1u << bits) - 1;
+    for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+        size_t bit = 0;
+        for (size_t i = 0; i < VALUES_PER_LANE; ++i, bit += bits) {
+            const size_t word = bit / 32;
+            const unsigned shift = bit % 32;
+            uint32_t value = words[word * LANE_COUNT + lane] >> shift;
+            if (shift + bits > 32) {
+                value |= words[(word + 1) * LANE_COUNT + lane] << (32 - shift);
+            }
+            values[i * LANE_COUNT + lane] = (value & mask) + offset_value;
+        }
+    }
+}
+
+void PrefixSum(uint32_t* values, uint32_t base) {
+    for (size_t i = 0; i < CompressedPostings::BLOCK_SIZE; ++i) {
+        base += values[i];
+        values[i] = base;
+    }
+}
+
+#endif
+
+} // namespace
+
+CompressedPostings::CompressedPostings(const int* document_ids, const uint32_t* term_counts, size_t size) {
+    owned_blocks_.reserve((size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    Encode(document_ids, term_counts, size);
+    owned_data_.shrink_to_fit();
+    PointToOwned();
+}
+
+void CompressedPostings::Append(const int* document_ids, const uint32_t* term_counts, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (owned_blocks_.empty() && block_count_ > 0) {
+        owned_blocks_.assign(blocks_, blocks_ + block_count_);
+        owned_data_.assign(data_, data_ + data_size_);
+        PointToOwned();
+    }
+    const size_t last_count = block_count_ == 0 ? 0 : size_ - (block_count_ - 1) * BLOCK_SIZE;
+    if (last_count == 0 || last_count == BLOCK_SIZE) {
+        Encode(document_ids, term_counts, size);
+        PointToOwned();
+        return;
+    }
+    // Every block but the last is full, so the last one is unpacked and packed
+    // again together with the new postings
+    std::vector<int> merged_ids(BLOCK_SIZE + size);
+    std::vector<uint32_t> merged_counts(BLOCK_SIZE + size);
+    DecodeBlock(block_count_ - 1, merged_ids.data(), merged_counts.data());
+    std::copy(document_ids, document_ids + size, merged_ids.begin() + last_count);
+    std::copy(term_counts, term_counts + size, merged_counts.begin() + last_count);
+    owned_data_.resize(owned_blocks_.back().offset);
+    owned_blocks_.pop_back();
+    size_ -= last_count;
+    Encode(merged_ids.data(), merged_counts.data(), last_count + size);
+    PointToOwned();
+}
+
+void CompressedPostings::Encode(const int* document_ids, const uint32_t* term_counts, size_t size) {
+    uint32_t deltas[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    uint32_t previous = owned_blocks_.empty() ? 0 : static_cast<uint32_t>(owned_blocks_.back().last_document_id);
+    size_ += size;
+    for (size_t first = 0; first < size; first += BLOCK_SIZE) {
+        const size_t count = std::min(BLOCK_SIZE, size - first);
+        uint32_t max_delta = 0;
+        uint32_t max_count = 0;
+        for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+            if (i < count) {
+                const uint32_t document_id = static_cast<uint32_t>(document_ids[first + i]);
+                deltas[i] = document_id - previous;
+                counts[i] = term_counts[first + i] - 1;
+                previous = document_id;
+            } else {
+                deltas[i] = 0;
+                counts[i] = 0;
+            }
+            max_delta = std::max(max_delta, deltas[i]);
+            max_count = std::max(max_count, counts[i]);
+        }
+        BlockHeader header;
+        header.last_document_id = static_cast<int32_t>(previous);
+        header.offset = static_cast<uint32_t>(owned_data_.size());
+        header.delta_bits = static_cast<uint8_t>(BitWidth(max_delta));
+        header.count_bits = static_cast<uint8_t>(BitWidth(max_count));
+        Pack(deltas, header.delta_bits, owned_data_);
+        Pack(counts, header.count_bits, owned_data_);
+        owned_blocks_.push_back(header);
+    }
+}
+
+void CompressedPostings::PointToOwned() {
+    blocks_ = owned_blocks_.data();
+    block_count_ = owned_blocks_.size();
+    data_ = owned_data_.data();
+    data_size_ = owned_data_.size();
+}
+
+CompressedPostings CompressedPostings::View(const BlockHeader* blocks, size_t block_count, const uint32_t* data, size_t data_size, size_t size) {
+    CompressedPostings postings;
+    postings.blocks_ = blocks;
+    postings.block_count_ = block_count;
+    postings.data_ = data;
+    postings.data_size_ = data_size;
+    postings.size_ = size;
+    return postings;
+}
+
+CompressedPostings::CompressedPostings(const CompressedPostings& other) {
+    *this = other;
+}
+
+CompressedPostings::CompressedPostings(CompressedPostings&& other) noexcept {
+    *this = std::move(other);
+}
+
+CompressedPostings& CompressedPostings::operator=(CompressedPostings&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    // Moving a vector keeps its buffer, so the pointers stay valid
+    owned_blocks_ = std::move(other.owned_blocks_);
+    owned_data_ = std::move(other.owned_data_);
+    blocks_ = std::exchange(other.blocks_, nullptr);
+    block_count_ = std::exchange(other.block_count_, 0);
+    data_ = std::exchange(other.data_, nullptr);
+    data_size_ = std::exchange(other.data_size_, 0);
+    size_ = std::exchange(other.size_, 0);
+    return *this;
+}
+
+CompressedPostings& CompressedPostings::operator=(const CompressedPostings& other) {
+    if (this == &other) {
+        return *this;
+    }
+    owned_blocks_ = other.owned_blocks_;
+    owned_data_ = other.owned_data_;
+    const bool is_view = other.owned_blocks_.empty() && other.block_count_ > 0;
+    blocks_ = is_view ? other.blocks_ : owned_blocks_.data();
+    data_ = is_view ? other.data_ : owned_data_.data();
+    block_count_ = other.block_count_;
+    data_size_ = other.data_size_;
+    size_ = other.size_;
+    return *this;
+}
+
+size_t CompressedPostings::DecodeBlock(size_t block, int* document_ids, uint32_t* term_counts) const {
+    const BlockHeader& header = blocks_[block];
+    const uint32_t* words = data_ + header.offset;
+    const uint32_t base = block == 0 ? 0 : static_cast<uint32_t>(blocks_[block - 1].last_document_id);
+    uint32_t* ids = reinterpret_cast<uint32_t*>(document_ids);
+    Unpack(words, header.delta_bits, 0, ids);
+    PrefixSum(ids, base);
+    // Counts are stored minus one
+    Unpack(words + header.delta_bits * LANE_COUNT, header.count_bits, 1, term_counts);
+    return block + 1 == block_count_ ? size_ - block * BLOCK_SIZE : BLOCK_SIZE;
+}
+
+size_t CompressedPostings::FindBlock(int document_id, size_t first_block) const {
+    auto it = std::lower_bound(blocks_ + first_block, blocks_ + block_count_, document_id,
+        [](const BlockHeader& header, int id) {
+            return header.last_document_id < id;
+        });
+    return it - blocks_;
+}
+
+size_t CompressedPostings::memory_usage() const {
+    return owned_blocks_.capacity() * sizeof(BlockHeader) + owned_data_.capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Posting list packed in blocks of BLOCK_SIZE postings, only ever appended to.
+// Document ids are delta-encoded, deltas and term counts are bit-packed
+// with the smallest width that fits the block. Words are interleaved in
+// four lanes, so a block unpacks with SSE2 when available, and scalar code otherwise.
+// Counts are kept exact, so that compressed lists score like plain ones
+class CompressedPostings {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    // Fixed layout, blocks are stored as is in index snapshots
+    struct BlockHeader {
+        int32_t last_document_id;
+        // Position of the block in data(), in 32-bit words
+        uint32_t offset;
+        uint8_t delta_bits;
+        uint8_t count_bits;
+        uint16_t reserved = 0;
+    };
+
+    CompressedPostings() = default;
+
+    // document_ids must be sorted and non-negative, term_counts positive
+    CompressedPostings(const int* document_ids, const uint32_t* term_counts, size_t size);
+
+    // Postings encoded elsewhere, e.g. in a mapped snapshot, which must outlive the object
+    static CompressedPostings View(const BlockHeader* blocks, size_t block_count, const uint32_t* data, size_t data_size, size_t size);
+
+    CompressedPostings(const CompressedPostings& other);
+    CompressedPostings& operator=(const CompressedPostings& other);
+    CompressedPostings(CompressedPostings&& other) noexcept;
+    CompressedPostings& operator=(CompressedPostings&& other) noexcept;
+
+    // Packs postings with ids above all present ones after them. Only a partly
+    // filled last block is packed again; a view is copied into owned memory first
+    void Append(const int* document_ids, const uint32_t* term_counts, size_t size);
+
+    size_t size() const {
+        return size_;
+    }
+
+    size_t block_count() const {
+        return block_count_;
+    }
+
+    // Largest document id in the block, lets cursors skip blocks without decoding them
+    int block_last_document_id(size_t block) const {
+        return blocks_[block].last_document_id;
+    }
+
+    const BlockHeader* blocks() const {
+        return blocks_;
+    }
+
+    const uint32_t* data() const {
+        return data_;
+    }
+
+    // In 32-bit words
+    size_t data_size() const {
+        return data_size_;
+    }
+
+    // Writes up to BLOCK_SIZE postings of the block, returns how many there are
+    size_t DecodeBlock(size_t block, int* document_ids, uint32_t* term_counts) const;
+
+    // Index of the first block that may contain document_id, block_count() if none
+    size_t FindBlock(int document_id, size_t first_block = 0) const;
+
+    // Calls f(document_id, term_count) for every posting in id order
+    template <typename Function>
+    void ForEach(Function f) const {
+        int document_ids[BLOCK_SIZE];
+        uint32_t term_counts[BLOCK_SIZE];
+        for (size_t block = 0; block < block_count_; ++block) {
+            const size_t count = DecodeBlock(block, document_ids, term_counts);
+            for (size_t i = 0; i < count; ++i) {
+                f(document_ids[i], term_counts[i]);
+            }
+        }
+    }
+
+    // Heap bytes owned by the object, a view owns none
+    size_t memory_usage() const;
+
+private:
+    // Either point into the owned vectors or into external memory
+    const BlockHeader* blocks_ = nullptr;
+    size_t block_count_ = 0;
+    const uint32_t* data_ = nullptr;
+    size_t data_size_ = 0;
+    size_t size_ = 0;
+
+    std::vector<BlockHeader> owned_blocks_;
+    std::vector<uint32_t> owned_data_;
+
+    // Packs postings into new owned blocks after the existing ones
+    void Encode(const int* document_ids, const uint32_t* term_counts, size_t size);
+
+    void PointToOwned();
+};
+
+static_assert(sizeof(CompressedPostings::BlockHeader) == 12);
@@ -0,0 +1,79 @@
+#include "concurrent_search_server.h"
+#include <thread>
+
+ConcurrentSearchServer::ConcurrentSearchServer(SearchServer search_server) {
+    servers_[0] = make_unique<SearchServer>(search_server);
+    servers_[1] = make_unique<SearchServer>(move(search_server));
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return Read([](const SearchServer& search_server) {
+        return search_server.GetDocumentCount();
+    });
+}
+
+void ConcurrentSearchServer::Update(const function<void(SearchServer&)>& update) {
+    lock_guard<mutex> guard(writer_mutex_);
+    const size_t published = current_.load();
+    const size_t standby = 1 - published;
+    // No reader is on the standby copy: the last update waited for them to leave
+    update(*servers_[standby]);
+    current_.store(standby);
+    WaitForReaders(published);
+    update(*servers_[published]);
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    Update([&](SearchServer& search_server) {
+        search_server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(const vector<DocumentInput>& documents) {
+    Update([&](SearchServer& search_server) {
+        search_server.AddDocuments(execution::par, documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Update([document_id](SearchServer& search_server) {
+        search_server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    Update([&](SearchServer& search_server) {
+        search_server.RemoveDocuments(document_ids);
+    });
+}
+
+size_t ConcurrentSearchServer::GetReaderSlot() {
+    static atomic<size_t> next_slot{ 0 };
+    thread_local const size_t slot = next_slot++ % READER_SLOT_COUNT;
+    return slot;
+}
+
+size_t ConcurrentSearchServer::EnterRead(size_t slot) const {
+    while (true) {
+        const size_t version = current_.load();
+        readers_[version][slot].count.fetch_add(1);
+        // Once counted, the copy cannot be modified until the count drops,
+        // unless a writer moved away from it before it saw the count
+        if (current_.load() == version) {
+            return version;
+        }
+        readers_[version][slot].count.fetch_sub(1);
+    }
+}
+
+void ConcurrentSearchServer::LeaveRead(size_t version, size_t slot) const {
+    readers_[version][slot].count.fetch_sub(1, memory_order_release);
+}
+
+void ConcurrentSearchServer::WaitForReaders(size_t version) const {
+    for (const ReaderSlot& reader_slot : readers_[version]) {
+        while (reader_slot.count.load() != 0) {
+            this_thread::yield();
+        }
+    }
+}
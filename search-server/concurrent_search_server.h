@@ -0,0 +1,100 @@
+#pragma once
+#include "document.h"
+#include "search_server.h"
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// SearchServer that answers queries while it is being updated.
+// Two copies of the index are kept (left-right): readers use the published copy,
+// and a writer applies an update to the other one, publishes it, waits for the
+// readers still on the old copy to leave and replays the update there.
+// Readers never take a lock and never wait for a writer; writers are serialised
+// among themselves. The price is twice the memory and every update applied twice
+class ConcurrentSearchServer {
+public:
+    explicit ConcurrentSearchServer(SearchServer search_server);
+
+    ConcurrentSearchServer(const ConcurrentSearchServer&) = delete;
+    ConcurrentSearchServer& operator=(const ConcurrentSearchServer&) = delete;
+
+    // Calls f(const SearchServer&) on the current version and returns its result.
+    // The version does not change under f, however long it runs
+    template <typename Function>
+    auto Read(Function f) const;
+
+    template <typename... Args>
+    vector<Document> FindTopDocuments(const Args&... args) const {
+        return Read([&](const SearchServer& search_server) {
+            return search_server.FindTopDocuments(args...);
+        });
+    }
+
+    // Matched words are views into a dictionary that updates only append to,
+    // so they outlive the read
+    template <typename... Args>
+    tuple<vector<string_view>, DocumentStatus> MatchDocument(const Args&... args) const {
+        return Read([&](const SearchServer& search_server) {
+            return search_server.MatchDocument(args...);
+        });
+    }
+
+    int GetDocumentCount() const;
+
+    // Applies update to the index and publishes the result. The update runs twice,
+    // once per copy, so it must be deterministic. If the first run throws, nothing
+    // is published and the exception propagates
+    void Update(const function<void(SearchServer&)>& update);
+
+    void AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings);
+
+    void AddDocuments(const vector<DocumentInput>& documents);
+
+    void RemoveDocument(int document_id);
+
+    void RemoveDocuments(const vector<int>& document_ids);
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    // Readers are counted on several cache lines, so they do not contend on one
+    static constexpr size_t READER_SLOT_COUNT = 16;
+
+    struct alignas(CACHE_LINE_SIZE) ReaderSlot {
+        atomic<int64_t> count{ 0 };
+    };
+
+    array<unique_ptr<SearchServer>, 2> servers_;
+    mutable array<array<ReaderSlot, READER_SLOT_COUNT>, 2> readers_;
+    // Index of the copy readers use
+    atomic<size_t> current_{ 0 };
+    mutex writer_mutex_;
+
+    static size_t GetReaderSlot();
+
+    // Registers the calling thread as a reader of the current copy and returns its index
+    size_t EnterRead(size_t slot) const;
+
+    void LeaveRead(size_t version, size_t slot) const;
+
+    void WaitForReaders(size_t version) const;
+};
+
+template <typename Function>
+auto ConcurrentSearchServer::Read(Function f) const {
+    struct Guard {
+        const ConcurrentSearchServer& owner;
+        size_t slot;
+        size_t version;
+
+        ~Guard() {
+            owner.LeaveRead(version, slot);
+        }
+    };
+    const size_t slot = GetReaderSlot();
+    const Guard guard{ *this, slot, EnterRead(slot) };
+    return f(static_cast<const SearchServer&>(*servers_[guard.version]));
+}
@@ -1,5 +1,17 @@
 #include "document.h"
 
+DocumentFilter::DocumentFilter(std::initializer_list<DocumentStatus> statuses, int min_rating, int max_rating)
+        : min_rating(min_rating)
+        , max_rating(max_rating) {
+        for (const DocumentStatus status : statuses) {
+            status_mask |= 1u << static_cast<int>(status);
+        }
+    }
+
+DocumentFilter::DocumentFilter(DocumentStatus status)
+        : DocumentFilter({ status }) {
+    }
+
 Document::Document() = default;
 
 Document::Document(int id, double relevance, int rating)
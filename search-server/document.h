@@ -1,6 +1,12 @@
 #pragma once
+#include <climits>
+#include <cstdint>
+#include <initializer_list>
 #include <iostream>
+#include <string_view>
+#include <vector>
 
+constexpr auto epsilon = 1e-6;
 
 enum class DocumentStatus {
     ACTUAL,
@@ -9,6 +15,39 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// Type relevance is accumulated in by execution::seq and execution::par
+enum class ScorePrecision {
+    DOUBLE,
+    FLOAT,
+};
+
+// A document to index with SearchServer::AddDocuments
+struct DocumentInput {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// Which documents FindTopDocuments may return. Applied through the bitmap of its
+// statuses and the sorted ratings, instead of a predicate call per posting
+struct DocumentFilter {
+    DocumentFilter(std::initializer_list<DocumentStatus> statuses = { DocumentStatus::ACTUAL },
+        int min_rating = INT_MIN, int max_rating = INT_MAX);
+
+    DocumentFilter(DocumentStatus status);
+
+    bool HasStatus(DocumentStatus status) const {
+        return (status_mask >> static_cast<int>(status)) & 1;
+    }
+
+    // Bit per DocumentStatus
+    uint32_t status_mask = 0;
+    // Inclusive bounds
+    int min_rating = INT_MIN;
+    int max_rating = INT_MAX;
+};
+
 struct Document {
     Document();
     Document(int id, double relevance, int rating);
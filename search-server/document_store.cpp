@@ -0,0 +1,129 @@
+#include "document_store.h"
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+// Until there are this many, additions and removals are not merged into the sorted ratings
+constexpr size_t MIN_PENDING_RATINGS = 256;
+
+}
+
+void DocumentStore::Add(int slot, int rating, DocumentStatus status, double inv_word_count) {
+    const size_t index = static_cast<size_t>(slot);
+    Reserve(index + 1);
+    ratings_[index] = rating;
+    statuses_[index] = status;
+    inv_word_counts_[index] = inv_word_count;
+    float_inv_word_counts_[index] = static_cast<float>(inv_word_count);
+    SetBit(present_, slot);
+    for (uint32_t mask = 1; mask < STATUS_MASK_COUNT; ++mask) {
+        if (mask >> static_cast<int>(status) & 1) {
+            SetBit(status_bits_[mask], slot);
+        }
+    }
+    by_rating_.emplace_back(rating, slot);
+    ++size_;
+    MergeRatings();
+}
+
+void DocumentStore::Remove(int slot) {
+    if (!Contains(slot)) {
+        return;
+    }
+    ClearBit(present_, slot);
+    const DocumentStatus status = statuses_[slot];
+    for (uint32_t mask = 1; mask < STATUS_MASK_COUNT; ++mask) {
+        if (mask >> static_cast<int>(status) & 1) {
+            ClearBit(status_bits_[mask], slot);
+        }
+    }
+    ++stale_ratings_;
+    --size_;
+    MergeRatings();
+}
+
+void DocumentStore::Reserve(size_t slot_count) {
+    if (slot_count > ratings_.size()) {
+        ratings_.resize(slot_count);
+        statuses_.resize(slot_count);
+        inv_word_counts_.resize(slot_count);
+        float_inv_word_counts_.resize(slot_count);
+        for (std::vector<uint64_t>& bits : status_bits_) {
+            bits.resize((slot_count + 63) / 64);
+        }
+    }
+}
+
+const std::vector<uint64_t>& DocumentStore::Select(const DocumentFilter& filter, std::vector<uint64_t>& bits, bool& exact) const {
+    const std::vector<uint64_t>& status_bits = this->status_bits(filter.status_mask);
+    exact = filter.min_rating == INT_MIN && filter.max_rating == INT_MAX;
+    if (exact) {
+        return status_bits;
+    }
+    exact = true;
+    if (filter.min_rating > filter.max_rating) {
+        bits.assign(status_bits.size(), 0);
+        return bits;
+    }
+    const auto sorted_end = by_rating_.begin() + sorted_ratings_;
+    const auto first = std::lower_bound(by_rating_.begin(), sorted_end, std::pair{ filter.min_rating, INT_MIN });
+    const auto last = std::upper_bound(first, sorted_end, std::pair{ filter.max_rating, INT_MAX });
+    // A wide range is cheaper to test per document than to select
+    if (static_cast<size_t>(last - first) > size_ / 16) {
+        exact = false;
+        return status_bits;
+    }
+    bits.assign(status_bits.size(), 0);
+    auto select = [&](const std::pair<int, int>& entry) {
+        if (entry.first >= filter.min_rating && entry.first <= filter.max_rating && IsCurrent(entry)
+            && filter.HasStatus(statuses_[entry.second])) {
+            SetBit(bits, entry.second);
+        }
+    };
+    std::for_each(first, last, select);
+    std::for_each(sorted_end, by_rating_.end(), select);
+    return bits;
+}
+
+void DocumentStore::MergeRatings() {
+    const size_t pending = by_rating_.size() - sorted_ratings_ + stale_ratings_;
+    if (pending <= std::max(MIN_PENDING_RATINGS, sorted_ratings_ / 32)) {
+        return;
+    }
+    const auto sorted_end = by_rating_.begin() + sorted_ratings_;
+    std::sort(sorted_end, by_rating_.end());
+    std::inplace_merge(by_rating_.begin(), sorted_end, by_rating_.end());
+    // A slot added back with the same rating has two entries
+    by_rating_.erase(std::unique(by_rating_.begin(), by_rating_.end()), by_rating_.end());
+    by_rating_.erase(std::remove_if(by_rating_.begin(), by_rating_.end(), [this](const std::pair<int, int>& entry) {
+        return !IsCurrent(entry);
+    }), by_rating_.end());
+    sorted_ratings_ = by_rating_.size();
+    stale_ratings_ = 0;
+}
+
+size_t DocumentStore::memory_usage() const {
+    size_t bytes = ratings_.capacity() * sizeof(int) + statuses_.capacity() * sizeof(DocumentStatus)
+        + inv_word_counts_.capacity() * sizeof(double) + float_inv_word_counts_.capacity() * sizeof(float)
+        + present_.capacity() * sizeof(uint64_t) + by_rating_.capacity() * sizeof(std::pair<int, int>);
+    for (const std::vector<uint64_t>& bits : status_bits_) {
+        bytes += bits.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+void DocumentStore::SetBit(std::vector<uint64_t>& bits, int slot) {
+    const size_t word = static_cast<size_t>(slot) / 64;
+    if (word >= bits.size()) {
+        bits.resize(word + 1);
+    }
+    bits[word] |= uint64_t{1} << (slot % 64);
+}
+
+void DocumentStore::ClearBit(std::vector<uint64_t>& bits, int slot) {
+    const size_t word = static_cast<size_t>(slot) / 64;
+    if (word < bits.size()) {
+        bits[word] &= ~(uint64_t{1} << (slot % 64));
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "document.h"
+
+// Rating, status and inverse word count of the indexed documents, kept in
+// columns indexed by document slot so that scoring reads them without a lookup.
+// Every set of statuses also has a bitmap of its documents and ratings are kept
+// sorted, so that a DocumentFilter turns into a bitmap before a query is scored
+class DocumentStore {
+public:
+    static constexpr size_t STATUS_COUNT = 4;
+    // Status masks of DocumentFilter, each with a bitmap
+    static constexpr size_t STATUS_MASK_COUNT = size_t{1} << STATUS_COUNT;
+
+    // The document must be absent
+    void Add(int slot, int rating, DocumentStatus status, double inv_word_count);
+
+    // Does nothing for an absent document
+    void Remove(int slot);
+
+    // Sizes the columns for slots below slot_count, so that they can be read for any of them
+    void Reserve(size_t slot_count);
+
+    bool Contains(int slot) const {
+        return TestBit(present_, slot);
+    }
+
+    // The accessors below require the document to be present
+
+    int rating(int slot) const {
+        return ratings_[slot];
+    }
+
+    DocumentStatus status(int slot) const {
+        return statuses_[slot];
+    }
+
+    double inv_word_count(int slot) const {
+        return inv_word_counts_[slot];
+    }
+
+    // The inverse word count column, indexed by slot, for scoring many documents at once
+    const std::vector<double>& inv_word_counts() const {
+        return inv_word_counts_;
+    }
+
+    // The same column rounded to float, for float scoring
+    const std::vector<float>& float_inv_word_counts() const {
+        return float_inv_word_counts_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Bit per slot, set for the documents with any status of the mask.
+    // Covers every reserved slot, so it can be tested without a bounds check
+    const std::vector<uint64_t>& status_bits(uint32_t status_mask) const {
+        return status_bits_[status_mask % STATUS_MASK_COUNT];
+    }
+
+    const std::vector<uint64_t>& status_bits(DocumentStatus status) const {
+        return status_bits(1u << static_cast<int>(status));
+    }
+
+    // Returns the bits of the documents the filter admits. A narrow rating range
+    // is looked up in the sorted ratings and selected into bits, and the result
+    // needs no further check. Otherwise the bitmap of the filter's statuses is
+    // returned as is, false is stored in exact and the caller checks ratings
+    const std::vector<uint64_t>& Select(const DocumentFilter& filter, std::vector<uint64_t>& bits, bool& exact) const;
+
+    static bool TestBit(const std::vector<uint64_t>& bits, int slot) {
+        const size_t word = static_cast<size_t>(slot) / 64;
+        return word < bits.size() && (bits[word] >> (slot % 64) & 1);
+    }
+
+    // For bitmaps that cover the slot
+    static bool TestBit(const uint64_t* bits, int slot) {
+        const uint32_t index = static_cast<uint32_t>(slot);
+        return bits[index / 64] >> (index % 64) & 1;
+    }
+
+    size_t memory_usage() const;
+
+private:
+    std::vector<int> ratings_;
+    std::vector<DocumentStatus> statuses_;
+    std::vector<double> inv_word_counts_;
+    std::vector<float> float_inv_word_counts_;
+    std::vector<uint64_t> present_;
+    std::array<std::vector<uint64_t>, STATUS_MASK_COUNT> status_bits_;
+    // (rating, slot) of the documents, sorted up to sorted_ratings_ and followed by
+    // the latest additions. Removed documents keep their entries until the tail is
+    // merged in, which happens once it and the removals outgrow a fraction of the column
+    std::vector<std::pair<int, int>> by_rating_;
+    size_t sorted_ratings_ = 0;
+    size_t stale_ratings_ = 0;
+    size_t size_ = 0;
+
+    // Whether the entry of by_rating_ still describes a document
+    bool IsCurrent(const std::pair<int, int>& entry) const {
+        return Contains(entry.second) && ratings_[entry.second] == entry.first;
+    }
+
+    // Merges the tail and drops removed entries once there are enough of them
+    void MergeRatings();
+
+    static void SetBit(std::vector<uint64_t>& bits, int slot);
+
+    static void ClearBit(std::vector<uint64_t>& bits, int slot);
+};
@@ -0,0 +1,90 @@
+#include "forward_index.h"
+#include <algorithm>
+#include <numeric>
+
+void ForwardIndex::Add(int slot, const std::vector<std::pair<TermId, uint32_t>>& terms) {
+    // Slots without a document in between get empty entries
+    offsets_.resize(slot + 1, terms_.size());
+    sizes_.resize(slot + 1, 0);
+    sizes_[slot] = static_cast<uint32_t>(terms.size());
+    for (const auto& [term, term_count] : terms) {
+        terms_.push_back(term);
+        term_counts_.push_back(term_count);
+    }
+}
+
+void ForwardIndex::Remove(int slot) {
+    if (static_cast<size_t>(slot) >= sizes_.size()) {
+        return;
+    }
+    removed_count_ += sizes_[slot];
+    sizes_[slot] = 0;
+    if (removed_count_ * 2 > terms_.size()) {
+        Compact();
+    }
+}
+
+bool ForwardIndex::Contains(int slot, TermId term) const {
+    const Entry entry = Get(slot);
+    return std::binary_search(entry.terms, entry.terms + entry.size, term);
+}
+
+void ForwardIndex::Clear() {
+    // Assigning {} would keep the capacity
+    std::vector<uint64_t>().swap(offsets_);
+    std::vector<uint32_t>().swap(sizes_);
+    std::vector<TermId>().swap(terms_);
+    std::vector<uint32_t>().swap(term_counts_);
+    removed_count_ = 0;
+}
+
+size_t ForwardIndex::memory_usage() const {
+    return offsets_.capacity() * sizeof(uint64_t) + sizes_.capacity() * sizeof(uint32_t)
+        + terms_.capacity() * sizeof(TermId) + term_counts_.capacity() * sizeof(uint32_t);
+}
+
+void ForwardIndex::Compact() {
+    // Entries lie in slot order, so they only ever move towards the front
+    uint64_t kept = 0;
+    for (size_t slot = 0; slot < sizes_.size(); ++slot) {
+        const uint64_t offset = offsets_[slot];
+        offsets_[slot] = kept;
+        std::copy(terms_.begin() + offset, terms_.begin() + offset + sizes_[slot], terms_.begin() + kept);
+        std::copy(term_counts_.begin() + offset, term_counts_.begin() + offset + sizes_[slot], term_counts_.begin() + kept);
+        kept += sizes_[slot];
+    }
+    terms_.resize(kept);
+    term_counts_.resize(kept);
+    terms_.shrink_to_fit();
+    term_counts_.shrink_to_fit();
+    removed_count_ = 0;
+}
+
+WordFrequencies::WordFrequencies(const TermDictionary& dictionary, ForwardIndex::Entry entry, double inv_word_count,
+    std::shared_ptr<const void> owner)
+    : dictionary_(&dictionary)
+    , entry_(entry)
+    , inv_word_count_(inv_word_count)
+    , owner_(std::move(owner)) {
+}
+
+WordFrequencies::Iterator WordFrequencies::begin() const {
+    if (entry_.size < 2) {
+        return Iterator(*this, 0);
+    }
+    // Term ids follow the order words were first seen in
+    auto order = std::make_shared<std::vector<uint32_t>>(entry_.size);
+    std::iota(order->begin(), order->end(), 0);
+    std::sort(order->begin(), order->end(), [this](uint32_t lhs, uint32_t rhs) {
+        return dictionary_->GetWord(entry_.terms[lhs]) < dictionary_->GetWord(entry_.terms[rhs]);
+    });
+    return Iterator(*this, 0, std::move(order));
+}
+
+size_t WordFrequencies::count(std::string_view word) const {
+    if (dictionary_ == nullptr) {
+        return 0;
+    }
+    const auto term = dictionary_->Find(word);
+    return term && std::binary_search(entry_.terms, entry_.terms + entry_.size, *term) ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "term_dictionary.h"
+
+// Terms of every document with their counts, by document slot. A document's terms
+// are sorted by id and stored back to back with the others in two flat arrays, so
+// an entry costs 8 bytes instead of a tree node per word.
+// Documents are added in slot order; removed ones leave a gap that is reclaimed
+// once gaps make up half of the arrays
+class ForwardIndex {
+public:
+    // Terms and counts of one document, terms ascending
+    struct Entry {
+        const TermId* terms = nullptr;
+        const uint32_t* term_counts = nullptr;
+        size_t size = 0;
+    };
+
+    // The slot must be above all slots added so far, terms sorted by id
+    void Add(int slot, const std::vector<std::pair<TermId, uint32_t>>& terms);
+
+    void Remove(int slot);
+
+    // Empty for a slot without a document
+    Entry Get(int slot) const {
+        if (static_cast<size_t>(slot) >= sizes_.size()) {
+            return {};
+        }
+        return { terms_.data() + offsets_[slot], term_counts_.data() + offsets_[slot], sizes_[slot] };
+    }
+
+    bool Contains(int slot, TermId term) const;
+
+    // Inverts posting lists. for_each_posting(f) must call f(term, slot, term_count)
+    // for every posting, by ascending term; it is called twice
+    template <typename ForEachPosting>
+    void Build(size_t slot_count, ForEachPosting for_each_posting);
+
+    void Clear();
+
+    size_t memory_usage() const;
+
+private:
+    // Where each slot's terms start, and how many there are
+    std::vector<uint64_t> offsets_;
+    std::vector<uint32_t> sizes_;
+    std::vector<TermId> terms_;
+    std::vector<uint32_t> term_counts_;
+    // Entries of removed documents still in the arrays
+    size_t removed_count_ = 0;
+
+    void Compact();
+};
+
+template <typename ForEachPosting>
+void ForwardIndex::Build(size_t slot_count, ForEachPosting for_each_posting) {
+    Clear();
+    sizes_.assign(slot_count, 0);
+    for_each_posting([this](TermId, int slot, uint32_t) {
+        ++sizes_[slot];
+    });
+    offsets_.resize(slot_count);
+    uint64_t offset = 0;
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        offsets_[slot] = offset;
+        offset += sizes_[slot];
+    }
+    terms_.resize(offset);
+    term_counts_.resize(offset);
+    // Terms come in ascending order, so every document's terms end up sorted
+    std::vector<uint64_t> next(offsets_);
+    for_each_posting([this, &next](TermId term, int slot, uint32_t term_count) {
+        terms_[next[slot]] = term;
+        term_counts_[next[slot]] = term_count;
+        ++next[slot];
+    });
+}
+
+// Words of a document with their term frequencies, as returned by
+// SearchServer::GetWordFrequencies. Iterates over (word, frequency) pairs in
+// word order, like a map from word to frequency would. A view into the server,
+// valid until the server changes
+class WordFrequencies {
+public:
+    // Holds the current pair, so that references to it last until the next increment
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        // order lists entry positions by word, null to keep term id order
+        Iterator(const WordFrequencies& words, size_t index, std::shared_ptr<const std::vector<uint32_t>> order = nullptr)
+            : words_(&words)
+            , index_(index)
+            , order_(std::move(order)) {
+            Load();
+        }
+
+        reference operator*() const {
+            return value_;
+        }
+
+        pointer operator->() const {
+            return &value_;
+        }
+
+        Iterator& operator++() {
+            ++index_;
+            Load();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return index_ != other.index_;
+        }
+
+    private:
+        const WordFrequencies* words_;
+        size_t index_;
+        std::shared_ptr<const std::vector<uint32_t>> order_;
+        value_type value_;
+
+        void Load() {
+            const ForwardIndex::Entry& entry = words_->entry_;
+            if (index_ < entry.size) {
+                const size_t position = order_ ? (*order_)[index_] : index_;
+                value_ = { words_->dictionary_->GetWord(entry.terms[position]), entry.term_counts[position] * words_->inv_word_count_ };
+            }
+        }
+    };
+
+    WordFrequencies() = default;
+
+    // owner keeps the entry alive if it is not part of a ForwardIndex
+    WordFrequencies(const TermDictionary& dictionary, ForwardIndex::Entry entry, double inv_word_count,
+        std::shared_ptr<const void> owner = nullptr);
+
+    // Sorts the words, so a loop should call it once
+    Iterator begin() const;
+
+    Iterator end() const {
+        return Iterator(*this, entry_.size);
+    }
+
+    size_t size() const {
+        return entry_.size;
+    }
+
+    bool empty() const {
+        return entry_.size == 0;
+    }
+
+    size_t count(std::string_view word) const;
+
+    // Ascending term ids: documents with the same words have the same terms.
+    // Cheaper than iterating when the words themselves are not needed
+    const TermId* terms() const {
+        return entry_.terms;
+    }
+
+private:
+    const TermDictionary* dictionary_ = nullptr;
+    ForwardIndex::Entry entry_;
+    double inv_word_count_ = 0.0;
+    std::shared_ptr<const void> owner_;
+};
@@ -0,0 +1,226 @@
+#include "index_snapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace index_snapshot {
+
+namespace {
+constexpr size_t ALIGNMENT = 8;
+
+// End of the sections the header checksum covers, 0 if the header points outside the file
+uint64_t CheckedSize(const FileHeader& header, uint64_t file_size) {
+    const uint64_t offset = header.postings.offset;
+    if (offset < sizeof(FileHeader) || offset > file_size || offset % ALIGNMENT != 0
+        || header.term_count > (file_size - offset) / sizeof(PostingRecord)) {
+        return 0;
+    }
+    return offset + header.term_count * sizeof(PostingRecord);
+}
+
+uint64_t HeaderChecksum(const char* data, uint64_t checked_size) {
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    header.checksum = 0;
+    const uint64_t seed = Checksum(reinterpret_cast<const char*>(&header), sizeof(header));
+    return Checksum(data + sizeof(FileHeader), checked_size - sizeof(FileHeader), seed);
+}
+} // namespace
+
+uint64_t Checksum(const char* data, size_t size, uint64_t seed) {
+    uint64_t hash = seed;
+    for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    return hash;
+}
+
+std::shared_ptr<const MappedFile> MappedFile::Open(const std::string& path) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+#if !defined(_WIN32)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open index file " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot read index file " + path);
+    }
+    file->size_ = static_cast<size_t>(info.st_size);
+    if (file->size_ > 0) {
+        void* data = mmap(nullptr, file->size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            file->data_ = static_cast<const char*>(data);
+        }
+    }
+    close(fd);
+    if (file->data_ != nullptr || file->size_ == 0) {
+        return file;
+    }
+#endif
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open index file " + path);
+    }
+    file->buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    file->data_ = file->buffer_.data();
+    file->size_ = file->buffer_.size();
+    return file;
+}
+
+MappedFile::~MappedFile() {
+#if !defined(_WIN32)
+    if (data_ != nullptr && buffer_.empty()) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
+
+size_t Writer::WriteStrings(const std::vector<std::string_view>& strings) {
+    const size_t offset = Write(StringTableHeader{ strings.size() });
+    uint64_t position = 0;
+    Write(position);
+    for (std::string_view str : strings) {
+        position += str.size();
+        Write(position);
+    }
+    for (std::string_view str : strings) {
+        Write(str.data(), str.size());
+    }
+    Align();
+    return offset;
+}
+
+void Writer::Align() {
+    buffer_.resize((buffer_.size() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT, '\0');
+}
+
+void Writer::Save(const std::string& path) {
+    Align();
+    FileHeader& header = At<FileHeader>(0);
+    header.file_size = buffer_.size();
+    header.checksum = HeaderChecksum(buffer_.data(), CheckedSize(header, buffer_.size()));
+    // Written next to the target and renamed, so readers never see half a file
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        if (!out) {
+            throw std::runtime_error("Cannot write index file " + temp_path);
+        }
+    }
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("Cannot write index file " + path);
+    }
+}
+
+Reader::Reader(const MappedFile& file)
+    : file_(file) {
+    if (file.size() < sizeof(FileHeader) || reinterpret_cast<uintptr_t>(file.data()) % ALIGNMENT != 0) {
+        throw std::runtime_error("Index file is truncated");
+    }
+    header_ = reinterpret_cast<const FileHeader*>(file.data());
+    if (std::memcmp(header_->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not an index file");
+    }
+    if (header_->byte_order != BYTE_ORDER_MARK) {
+        throw std::runtime_error("Index file has a different byte order");
+    }
+    if (header_->version != VERSION) {
+        throw std::runtime_error("Unsupported index file version " + std::to_string(header_->version));
+    }
+    if (header_->file_size != file.size() || file.size() % ALIGNMENT != 0) {
+        throw std::runtime_error("Index file is truncated");
+    }
+    const uint64_t checked_size = CheckedSize(*header_, file.size());
+    if (checked_size == 0 || HeaderChecksum(file.data(), checked_size) != header_->checksum) {
+        throw std::runtime_error("Index file is corrupted");
+    }
+}
+
+std::vector<std::string_view> Reader::GetStrings(const Section& section) const {
+    const uint64_t count = Get<StringTableHeader>(section.offset, 1)->count;
+    if (count >= file_.size()) {
+        throw std::runtime_error("Index file is corrupted");
+    }
+    const uint64_t* offsets = Get<uint64_t>(section.offset + sizeof(StringTableHeader), count + 1);
+    const uint64_t chars_offset = section.offset + sizeof(StringTableHeader) + (count + 1) * sizeof(uint64_t);
+    const char* chars = Get<char>(chars_offset, offsets[count]);
+    std::vector<std::string_view> strings;
+    strings.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (offsets[i] > offsets[i + 1]) {
+            throw std::runtime_error("Index file is corrupted");
+        }
+        strings.emplace_back(chars + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return strings;
+}
+
+void Reader::Check(uint64_t offset, uint64_t count, size_t size, size_t alignment) const {
+    const uint64_t file_size = file_.size();
+    if (offset > file_size || offset % alignment != 0 || count > (file_size - offset) / size) {
+        throw std::runtime_error("Index file is corrupted");
+    }
+}
+
+PostingVerifier::PostingVerifier(std::shared_ptr<const MappedFile> file, const PostingRecord* records, size_t term_count, uint64_t slot_count)
+    : file_(std::move(file))
+    , records_(records)
+    , term_count_(term_count)
+    , slot_count_(slot_count)
+    , states_(new std::atomic<uint8_t>[term_count]) {
+    for (size_t term = 0; term < term_count; ++term) {
+        states_[term].store(UNCHECKED, std::memory_order_relaxed);
+    }
+}
+
+void PostingVerifier::VerifyList(uint32_t term) const {
+    std::atomic<uint8_t>& state = states_[term];
+    if (state.load(std::memory_order_acquire) == CORRUPTED) {
+        throw std::runtime_error("Index file is corrupted");
+    }
+    // Two threads may check the same list at once, both come to the same result
+    const PostingRecord& record = records_[term];
+    // A term without postings in the snapshot has nothing to check
+    bool valid = record.size == 0 || Checksum(file_->data() + record.blocks_offset, PostingExtent(record)) == record.checksum;
+    const auto* blocks = reinterpret_cast<const CompressedPostings::BlockHeader*>(file_->data() + record.blocks_offset);
+    for (uint64_t block = 0; valid && block < record.block_count; ++block) {
+        const uint64_t words_used = (blocks[block].delta_bits + blocks[block].count_bits) * uint64_t{4};
+        valid = blocks[block].delta_bits <= 32 && blocks[block].count_bits <= 32 && blocks[block].offset + words_used <= record.data_size;
+    }
+    if (valid && record.size > 0) {
+        const auto* data = reinterpret_cast<const uint32_t*>(file_->data() + record.data_offset);
+        const auto compressed = CompressedPostings::View(blocks, record.block_count, data, record.data_size, record.size);
+        int document_ids[CompressedPostings::BLOCK_SIZE];
+        uint32_t term_counts[CompressedPostings::BLOCK_SIZE];
+        int64_t previous = -1;
+        for (size_t block = 0; valid && block < compressed.block_count(); ++block) {
+            const size_t count = compressed.DecodeBlock(block, document_ids, term_counts);
+            for (size_t i = 0; valid && i < count; ++i) {
+                valid = document_ids[i] > previous && static_cast<uint64_t>(document_ids[i]) < slot_count_ && term_counts[i] > 0;
+                previous = document_ids[i];
+            }
+            // Cursors skip blocks by the last id in the header
+            valid = valid && document_ids[count - 1] == compressed.block_last_document_id(block);
+        }
+    }
+    state.store(valid ? VERIFIED : CORRUPTED, std::memory_order_release);
+    if (!valid) {
+        throw std::runtime_error("Index file is corrupted");
+    }
+}
+
+} // namespace index_snapshot
@@ -0,0 +1,214 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "compressed_postings.h"
+
+// On-disk layout of SearchServer::SaveIndex. All sections are 8-byte aligned and
+// stored in host byte order, so posting blocks and words are used in place from the mapping.
+//
+//   FileHeader
+//   stop words:  StringTableHeader, uint64_t offsets[count + 1], chars
+//   documents:   DocumentRecord[document_count], in slot order
+//   terms:       StringTableHeader, uint64_t offsets[count + 1], chars; index is the term id
+//   postings:    PostingRecord[term_count], then BlockHeader and data words they point to
+//
+// The header checksum covers everything up to the posting blocks. Each list has
+// its own checksum, checked when the list is first used, so loading does not
+// read the posting blocks
+namespace index_snapshot {
+
+inline constexpr char MAGIC[8] = { 'S', 'R', 'C', 'H', 'I', 'D', 'X', '\0' };
+inline constexpr uint32_t VERSION = 3;
+// Reads back differently on a machine with the other byte order
+inline constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct Section {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    // Of the header, taken with this field zeroed, and the sections before the posting blocks
+    uint64_t checksum;
+    uint64_t max_result_document_count;
+    uint64_t document_count;
+    // Document slots are below it, posting lists refer to slots
+    uint64_t slot_count;
+    uint64_t term_count;
+    Section stop_words;
+    Section documents;
+    Section terms;
+    Section postings;
+};
+
+struct StringTableHeader {
+    uint64_t count;
+};
+
+struct DocumentRecord {
+    int32_t document_id;
+    int32_t rating;
+    int32_t status;
+    // Number of the document inside SearchServer, which posting lists refer to
+    int32_t slot;
+    double inv_word_count;
+};
+
+// Offsets are relative to the start of the file; size 0 for a term without postings
+struct PostingRecord {
+    uint64_t blocks_offset;
+    uint64_t data_offset;
+    uint64_t block_count;
+    uint64_t data_size;
+    uint64_t size;
+    double max_term_freq;
+    // Of the blocks and data words, padding included
+    uint64_t checksum;
+};
+
+static_assert(sizeof(FileHeader) == 128);
+static_assert(sizeof(DocumentRecord) == 24);
+static_assert(sizeof(PostingRecord) == 56);
+
+inline constexpr uint64_t CHECKSUM_SEED = 14695981039346656037ull;
+
+// 64-bit FNV-1a over 8-byte words, size must be a multiple of 8. Pass the
+// checksum of the preceding bytes as seed to continue it
+uint64_t Checksum(const char* data, size_t size, uint64_t seed = CHECKSUM_SEED);
+
+// Bytes from the start of the blocks of a list to the end of its data words, padding included
+inline uint64_t PostingExtent(const PostingRecord& record) {
+    const uint64_t end = record.data_offset + record.data_size * sizeof(uint32_t);
+    return (end + 7) / 8 * 8 - record.blocks_offset;
+}
+
+// Read-only view of a whole file, memory-mapped where the platform allows
+class MappedFile {
+public:
+    // Throws runtime_error if the file cannot be opened
+    static std::shared_ptr<const MappedFile> Open(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    MappedFile() = default;
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    // Used when the file cannot be mapped
+    std::vector<char> buffer_;
+};
+
+// Appends sections to a buffer keeping them aligned
+class Writer {
+public:
+    size_t size() const {
+        return buffer_.size();
+    }
+
+    template <typename T>
+    size_t Write(const T* values, size_t count) {
+        const size_t offset = buffer_.size();
+        const char* bytes = reinterpret_cast<const char*>(values);
+        buffer_.insert(buffer_.end(), bytes, bytes + count * sizeof(T));
+        return offset;
+    }
+
+    template <typename T>
+    size_t Write(const T& value) {
+        return Write(&value, 1);
+    }
+
+    size_t WriteStrings(const std::vector<std::string_view>& strings);
+
+    void Align();
+
+    template <typename T>
+    T& At(size_t offset) {
+        return *reinterpret_cast<T*>(buffer_.data() + offset);
+    }
+
+    uint64_t Checksum(size_t offset, size_t size) const {
+        return index_snapshot::Checksum(buffer_.data() + offset, size);
+    }
+
+    // Fills in file size and checksum, then writes the file. Throws runtime_error on failure
+    void Save(const std::string& path);
+
+private:
+    std::vector<char> buffer_;
+};
+
+// Checked access to a mapped snapshot, throws runtime_error on anything out of bounds
+class Reader {
+public:
+    explicit Reader(const MappedFile& file);
+
+    const FileHeader& header() const {
+        return *header_;
+    }
+
+    template <typename T>
+    const T* Get(uint64_t offset, uint64_t count) const {
+        Check(offset, count, sizeof(T), alignof(T));
+        return reinterpret_cast<const T*>(file_.data() + offset);
+    }
+
+    // Views into the file
+    std::vector<std::string_view> GetStrings(const Section& section) const;
+
+private:
+    const MappedFile& file_;
+    const FileHeader* header_;
+
+    void Check(uint64_t offset, uint64_t count, size_t size, size_t alignment) const;
+};
+
+// Checks the posting lists of a snapshot the first time they are used: checksum,
+// block headers, and that the slots ascend and stay below the slot count.
+// Shared by all copies of the loaded index, may be called concurrently
+class PostingVerifier {
+public:
+    // The records must have been bounds-checked by a Reader
+    PostingVerifier(std::shared_ptr<const MappedFile> file, const PostingRecord* records, size_t term_count, uint64_t slot_count);
+
+    // Throws runtime_error if the list of the term is corrupted. Terms past
+    // the snapshot's ones are not checked
+    void Verify(uint32_t term) const {
+        if (term < term_count_ && states_[term].load(std::memory_order_acquire) != VERIFIED) {
+            VerifyList(term);
+        }
+    }
+
+private:
+    enum State : uint8_t { UNCHECKED, VERIFIED, CORRUPTED };
+
+    std::shared_ptr<const MappedFile> file_;
+    const PostingRecord* records_;
+    size_t term_count_;
+    uint64_t slot_count_;
+    std::unique_ptr<std::atomic<uint8_t>[]> states_;
+
+    void VerifyList(uint32_t term) const;
+};
+
+} // namespace index_snapshot
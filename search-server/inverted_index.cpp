@@ -0,0 +1,296 @@
+#include "inverted_index.h"
+#include <cmath>
+#include <numeric>
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+    : postings_(&postings) {
+    if (postings.compressed_.block_count() > 0) {
+        decoded_ = std::make_unique<DecodedBlock>();
+        LoadBlock(0);
+    } else {
+        document_ids_ = postings.document_ids_.data();
+        term_counts_ = postings.term_counts_.data();
+        end_ = postings.document_ids_.size();
+    }
+    UpdateDocumentId();
+}
+
+void PostingList::Cursor::LoadBlock(size_t block) {
+    const CompressedPostings& compressed = postings_->compressed_;
+    block_ = block;
+    position_ = 0;
+    if (block < compressed.block_count()) {
+        document_ids_ = decoded_->document_ids;
+        term_counts_ = decoded_->term_counts;
+        end_ = compressed.DecodeBlock(block, decoded_->document_ids, decoded_->term_counts);
+    } else if (block == compressed.block_count()) {
+        // The tail comes after the last block
+        document_ids_ = postings_->document_ids_.data();
+        term_counts_ = postings_->term_counts_.data();
+        end_ = postings_->document_ids_.size();
+    } else {
+        end_ = 0;
+    }
+}
+
+void PostingList::Cursor::SkipTo(int document_id) {
+    if (AtEnd() || this->document_id() >= document_id) {
+        return;
+    }
+    if (decoded_) {
+        const CompressedPostings& compressed = postings_->compressed_;
+        if (block_ < compressed.block_count() && compressed.block_last_document_id(block_) < document_id) {
+            // Whole blocks are skipped by their headers, without decoding
+            LoadBlock(compressed.FindBlock(document_id, block_ + 1));
+            if (AtEnd()) {
+                UpdateDocumentId();
+                return;
+            }
+        }
+    }
+    const int* first = document_ids_;
+    // Gallop forward first: targets are usually close to the current position
+    size_t low = position_;
+    size_t step = 1;
+    while (low + step < end_ && first[low + step] < document_id) {
+        low += step;
+        step *= 2;
+    }
+    const size_t high = std::min(low + step + 1, end_);
+    position_ = std::lower_bound(first + low, first + high, document_id) - first;
+    if (position_ == end_ && decoded_) {
+        LoadBlock(block_ + 1);
+    }
+    UpdateDocumentId();
+}
+
+PostingList::PostingList(CompressedPostings compressed, double max_term_freq)
+    : compressed_(std::move(compressed))
+    , max_term_freq_(max_term_freq)
+    , log_size_stale_(true) {
+    Refresh();
+}
+
+void PostingList::Add(int document_id, uint32_t term_count, double term_freq) {
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+    // Documents are usually added with increasing ids, so appending is the common case
+    if (last_document_id() < document_id) {
+        document_ids_.push_back(document_id);
+        term_counts_.push_back(term_count);
+        if (compressed_.size() > 0 && document_ids_.size() == CompressedPostings::BLOCK_SIZE) {
+            compressed_.Append(document_ids_.data(), term_counts_.data(), document_ids_.size());
+            document_ids_.clear();
+            term_counts_.clear();
+        }
+        log_size_stale_ = true;
+        return;
+    }
+    Decompress();
+    auto it = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    const size_t index = it - document_ids_.begin();
+    if (it != document_ids_.end() && *it == document_id) {
+        term_counts_[index] += term_count;
+        return;
+    }
+    document_ids_.insert(it, document_id);
+    term_counts_.insert(term_counts_.begin() + index, term_count);
+    log_size_stale_ = true;
+}
+
+void PostingList::Remove(int document_id) {
+    if (!Contains(document_id)) {
+        return;
+    }
+    Decompress();
+    auto it = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    term_counts_.erase(term_counts_.begin() + (it - document_ids_.begin()));
+    document_ids_.erase(it);
+    log_size_stale_ = true;
+}
+
+void PostingList::MarkRemoved() {
+    ++removed_count_;
+    log_size_stale_ = true;
+}
+
+void PostingList::Purge(const std::vector<bool>& removed) {
+    if (removed_count_ == 0) {
+        return;
+    }
+    const bool was_compressed = compressed_.size() > 0;
+    Decompress();
+    size_t kept = 0;
+    for (size_t i = 0; i < document_ids_.size(); ++i) {
+        const size_t document_id = static_cast<size_t>(document_ids_[i]);
+        if (document_id < removed.size() && removed[document_id]) {
+            continue;
+        }
+        document_ids_[kept] = document_ids_[i];
+        term_counts_[kept] = term_counts_[i];
+        ++kept;
+    }
+    document_ids_.resize(kept);
+    term_counts_.resize(kept);
+    removed_count_ = 0;
+    log_size_stale_ = true;
+    if (was_compressed) {
+        Compress();
+    }
+}
+
+void PostingList::Renumber(const std::vector<int>& new_ids) {
+    // Ids below the first gap keep their numbers, so lists that end before it stay as they are
+    const int last = last_document_id();
+    if (last < 0 || new_ids[last] == last) {
+        return;
+    }
+    const bool was_compressed = compressed_.size() > 0;
+    Decompress();
+    size_t kept = 0;
+    for (size_t i = 0; i < document_ids_.size(); ++i) {
+        const int document_id = new_ids[document_ids_[i]];
+        if (document_id < 0) {
+            continue;
+        }
+        document_ids_[kept] = document_id;
+        term_counts_[kept] = term_counts_[i];
+        ++kept;
+    }
+    document_ids_.resize(kept);
+    term_counts_.resize(kept);
+    removed_count_ = 0;
+    log_size_stale_ = true;
+    if (was_compressed) {
+        Compress();
+    }
+}
+
+uint32_t PostingList::TermCount(int document_id) const {
+    const size_t block = compressed_.FindBlock(document_id);
+    if (block == compressed_.block_count()) {
+        const auto it = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+        return it != document_ids_.end() && *it == document_id ? term_counts_[it - document_ids_.begin()] : 0;
+    }
+    int document_ids[CompressedPostings::BLOCK_SIZE];
+    uint32_t term_counts[CompressedPostings::BLOCK_SIZE];
+    const size_t count = compressed_.DecodeBlock(block, document_ids, term_counts);
+    const int* it = std::lower_bound(document_ids, document_ids + count, document_id);
+    return it != document_ids + count && *it == document_id ? term_counts[it - document_ids] : 0;
+}
+
+void PostingList::Compress() {
+    if (document_ids_.empty()) {
+        return;
+    }
+    if (compressed_.size() == 0) {
+        compressed_ = CompressedPostings(document_ids_.data(), term_counts_.data(), document_ids_.size());
+    } else {
+        compressed_.Append(document_ids_.data(), term_counts_.data(), document_ids_.size());
+    }
+    // Assigning {} would keep the capacity
+    std::vector<int>().swap(document_ids_);
+    std::vector<uint32_t>().swap(term_counts_);
+}
+
+void PostingList::Decompress() {
+    if (compressed_.size() == 0) {
+        return;
+    }
+    std::vector<int> document_ids;
+    std::vector<uint32_t> term_counts;
+    document_ids.reserve(size());
+    term_counts.reserve(size());
+    compressed_.ForEach([&](int document_id, uint32_t term_count) {
+        document_ids.push_back(document_id);
+        term_counts.push_back(term_count);
+    });
+    document_ids.insert(document_ids.end(), document_ids_.begin(), document_ids_.end());
+    term_counts.insert(term_counts.end(), term_counts_.begin(), term_counts_.end());
+    document_ids_.swap(document_ids);
+    term_counts_.swap(term_counts);
+    compressed_ = {};
+}
+
+ptrdiff_t PostingList::Refresh() {
+    if (log_size_stale_) {
+        log_size_ = live_size() == 0 ? 0.0 : std::log(static_cast<double>(live_size()));
+        log_size_stale_ = false;
+    }
+    const ptrdiff_t change = static_cast<ptrdiff_t>(size()) - static_cast<ptrdiff_t>(refreshed_size_);
+    refreshed_size_ = size();
+    return change;
+}
+
+size_t PostingList::memory_usage() const {
+    return document_ids_.capacity() * sizeof(int) + term_counts_.capacity() * sizeof(uint32_t) + compressed_.memory_usage();
+}
+
+void InvertedIndex::Add(TermId term, int document_id, uint32_t term_count, double term_freq) {
+    if (term >= postings_.size()) {
+        postings_.resize(term + 1);
+    }
+    Verify(term);
+    postings_[term].Add(document_id, term_count, term_freq);
+}
+
+void InvertedIndex::Remove(TermId term, int document_id) {
+    if (term >= postings_.size()) {
+        return;
+    }
+    Verify(term);
+    postings_[term].Remove(document_id);
+    Refresh(term);
+}
+
+void InvertedIndex::MarkRemoved(TermId term) {
+    postings_[term].MarkRemoved();
+}
+
+void InvertedIndex::Refresh(TermId term) {
+    PostingList& postings = postings_[term];
+    posting_count_ += postings.Refresh();
+    if (postings.empty()) {
+        // Give the memory back, the slot stays reserved for the term
+        postings = PostingList();
+    }
+}
+
+void InvertedIndex::Reserve(size_t term_count) {
+    if (term_count > postings_.size()) {
+        postings_.resize(term_count);
+    }
+}
+
+void InvertedIndex::Set(TermId term, PostingList postings) {
+    if (term >= postings_.size()) {
+        postings_.resize(term + 1);
+    }
+    posting_count_ += postings.size();
+    posting_count_ -= postings_[term].size();
+    postings_[term] = std::move(postings);
+}
+
+const PostingList* InvertedIndex::Find(TermId term) const {
+    if (term >= postings_.size() || postings_[term].live_size() == 0) {
+        return nullptr;
+    }
+    Verify(term);
+    return &postings_[term];
+}
+
+void InvertedIndex::SetVerifier(std::shared_ptr<const index_snapshot::PostingVerifier> verifier) {
+    verifier_ = std::move(verifier);
+}
+
+void InvertedIndex::Compress() {
+    for (PostingList& postings : postings_) {
+        postings.Compress();
+    }
+}
+
+size_t InvertedIndex::memory_usage() const {
+    return std::accumulate(postings_.begin(), postings_.end(), postings_.capacity() * sizeof(PostingList),
+        [](size_t sum, const PostingList& postings) {
+            return sum + postings.memory_usage();
+        });
+}
@@ -0,0 +1,324 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <memory>
+#include <vector>
+#include "compressed_postings.h"
+#include "index_snapshot.h"
+#include "term_dictionary.h"
+
+// Posting list of a single word, sorted by document slot. A posting keeps how many
+// times the word occurs in the document, the frequency is that count times
+// the document's inverse word count.
+// The list is a sealed CompressedPostings segment followed by a plain mutable
+// tail. Once a list has been compressed, postings appended in slot order gather
+// in the tail and are sealed into the segment block by block, so the list stays
+// compact without being unpacked. Other edits turn the whole list back into
+// plain arrays
+class PostingList {
+public:
+    // Forward-only position in the list. Past the end document_id() is INT_MAX
+    class Cursor {
+    public:
+        explicit Cursor(const PostingList& postings);
+
+        int document_id() const {
+            return document_id_;
+        }
+
+        uint32_t term_count() const {
+            return term_counts_[position_];
+        }
+
+        bool AtEnd() const {
+            return position_ >= end_;
+        }
+
+        void Next() {
+            if (++position_ == end_ && decoded_) {
+                LoadBlock(block_ + 1);
+            }
+            UpdateDocumentId();
+        }
+
+        // Moves to the first posting with id >= document_id
+        void SkipTo(int document_id);
+
+    private:
+        const PostingList* postings_;
+        // Cached, WAND reads it far more often than the cursor moves
+        int document_id_ = INT_MAX;
+        // The plain arrays of the list, or the decoded block
+        const int* document_ids_ = nullptr;
+        const uint32_t* term_counts_ = nullptr;
+        size_t position_ = 0;
+        size_t end_ = 0;
+        size_t block_ = 0;
+
+        // Current block of a compressed list, null for plain lists. Kept out of line
+        // so that the cursors of a long query stay small
+        struct DecodedBlock {
+            int document_ids[CompressedPostings::BLOCK_SIZE];
+            uint32_t term_counts[CompressedPostings::BLOCK_SIZE];
+        };
+        std::unique_ptr<DecodedBlock> decoded_;
+
+        void LoadBlock(size_t block);
+
+        void UpdateDocumentId() {
+            document_id_ = AtEnd() ? INT_MAX : document_ids_[position_];
+        }
+    };
+
+    PostingList() = default;
+
+    // A list that starts out compressed, e.g. loaded from a snapshot
+    PostingList(CompressedPostings compressed, double max_term_freq);
+
+    // term_freq is only used to keep max_term_freq up to date.
+    // Edits leave log_size() stale until Refresh
+    void Add(int document_id, uint32_t term_count, double term_freq);
+
+    void Remove(int document_id);
+
+    // Counts one posting as belonging to a removed document. It stays in the list,
+    // but no longer counts in live_size() and log_size(), until Purge drops it
+    void MarkRemoved();
+
+    // Drops the postings of documents marked in removed, indexed by document id
+    void Purge(const std::vector<bool>& removed);
+
+    // Moves the posting of every document id to new_ids[id] and drops those mapped
+    // to -1. new_ids must keep the order of the ids it keeps
+    void Renumber(const std::vector<int>& new_ids);
+
+    bool Contains(int document_id) const {
+        return TermCount(document_id) > 0;
+    }
+
+    // How many times the word occurs in the document, 0 if not at all
+    uint32_t TermCount(int document_id) const;
+
+    // Calls f(document_id, term_count) for every posting in id order
+    template <typename Function>
+    void ForEach(Function f) const {
+        compressed_.ForEach(f);
+        for (size_t i = 0; i < document_ids_.size(); ++i) {
+            f(document_ids_[i], term_counts_[i]);
+        }
+    }
+
+    // Calls f(document_ids, term_counts, count) for runs of at most BLOCK_SIZE postings
+    // with ids in [first, last), in id order. Sealed blocks are decoded once each
+    template <typename Function>
+    void ForEachRun(int first, int last, Function f) const;
+
+    size_t size() const {
+        return compressed_.size() + document_ids_.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Postings of documents not marked removed
+    size_t live_size() const {
+        return size() - removed_count_;
+    }
+
+    size_t removed_count() const {
+        return removed_count_;
+    }
+
+    // log(live_size()), precomputed so that queries compute IDF without calling log
+    double log_size() const {
+        return log_size_;
+    }
+
+    // Brings log_size() up to date after edits, so that a batch of them costs one
+    // log per list rather than one per posting. Returns how much size() changed
+    // since the previous call
+    ptrdiff_t Refresh();
+
+    // Upper bound of term frequency over the list; not lowered on removal
+    double max_term_freq() const {
+        return max_term_freq_;
+    }
+
+    // Seals the tail
+    void Compress();
+
+    bool IsCompressed() const {
+        return compressed_.size() > 0 && document_ids_.empty();
+    }
+
+    // nullptr unless the whole list is sealed
+    const CompressedPostings* compressed() const {
+        return IsCompressed() ? &compressed_ : nullptr;
+    }
+
+    size_t memory_usage() const;
+
+private:
+    // The tail, with ids above all ids in compressed_
+    std::vector<int> document_ids_;
+    std::vector<uint32_t> term_counts_;
+    CompressedPostings compressed_;
+    size_t removed_count_ = 0;
+    double max_term_freq_ = 0.0;
+    double log_size_ = 0.0;
+    bool log_size_stale_ = false;
+    // size() at the last Refresh
+    size_t refreshed_size_ = 0;
+
+    // Sealed postings are moved to the front of the tail
+    void Decompress();
+
+    int last_document_id() const {
+        if (!document_ids_.empty()) {
+            return document_ids_.back();
+        }
+        return compressed_.block_count() == 0 ? -1 : compressed_.block_last_document_id(compressed_.block_count() - 1);
+    }
+};
+
+// Flat posting lists addressed by term id
+class InvertedIndex {
+public:
+    // Call Refresh for the term once the batch of additions is done
+    void Add(TermId term, int document_id, uint32_t term_count, double term_freq);
+
+    void Remove(TermId term, int document_id);
+
+    // Removes document_id from the posting lists of all terms, in parallel if the policy allows
+    template <typename Policy, typename Terms>
+    void Remove(const Policy& policy, const Terms& terms, int document_id);
+
+    // See PostingList::MarkRemoved, Refresh applies as for Add
+    void MarkRemoved(TermId term);
+
+    // Brings log_size() of the term's list and posting_count() up to date after
+    // Add or MarkRemoved. Must not run concurrently with other edits
+    void Refresh(TermId term);
+
+    // Drops the postings of removed documents from the lists of the given distinct terms,
+    // in parallel if the policy allows
+    template <typename Policy, typename Terms>
+    void Purge(const Policy& policy, const Terms& terms, const std::vector<bool>& removed);
+
+    // Renumbers the documents of every list, see PostingList::Renumber,
+    // in parallel if the policy allows
+    template <typename Policy>
+    void Renumber(const Policy& policy, const std::vector<int>& new_ids);
+
+    // nullptr if no live document contains the term
+    const PostingList* Find(TermId term) const;
+
+    // Makes room for terms below term_count. Afterwards Add may run
+    // concurrently as long as the calls touch different terms below it
+    void Reserve(size_t term_count);
+
+    // Replaces the list of the term
+    void Set(TermId term, PostingList postings);
+
+    // Lists loaded from a snapshot are checked by the verifier before they are first
+    // read or edited; Find and the editing methods throw runtime_error for a corrupted one
+    void SetVerifier(std::shared_ptr<const index_snapshot::PostingVerifier> verifier);
+
+    // Packs every posting list; lists edited afterwards are unpacked again
+    void Compress();
+
+    // Kept up to date as lists change, postings of removed documents included
+    size_t posting_count() const {
+        return posting_count_;
+    }
+
+    size_t memory_usage() const;
+
+private:
+    std::vector<PostingList> postings_;
+    size_t posting_count_ = 0;
+    std::shared_ptr<const index_snapshot::PostingVerifier> verifier_;
+
+    void Verify(TermId term) const {
+        if (verifier_) {
+            verifier_->Verify(term);
+        }
+    }
+};
+
+template <typename Function>
+void PostingList::ForEachRun(int first, int last, Function f) const {
+    constexpr size_t BLOCK_SIZE = CompressedPostings::BLOCK_SIZE;
+    int document_ids[BLOCK_SIZE];
+    uint32_t term_counts[BLOCK_SIZE];
+    for (size_t block = compressed_.FindBlock(first); block < compressed_.block_count(); ++block) {
+        const size_t count = compressed_.DecodeBlock(block, document_ids, term_counts);
+        const size_t begin = std::lower_bound(document_ids, document_ids + count, first) - document_ids;
+        const size_t end = document_ids[count - 1] < last ? count : std::lower_bound(document_ids + begin, document_ids + count, last) - document_ids;
+        if (begin < end) {
+            f(document_ids + begin, term_counts + begin, end - begin);
+        }
+        if (end < count) {
+            return;
+        }
+    }
+    // The tail holds the highest ids
+    const size_t begin = std::lower_bound(document_ids_.begin(), document_ids_.end(), first) - document_ids_.begin();
+    const size_t end = std::lower_bound(document_ids_.begin() + begin, document_ids_.end(), last) - document_ids_.begin();
+    for (size_t run = begin; run < end; run += BLOCK_SIZE) {
+        f(document_ids_.data() + run, term_counts_.data() + run, std::min(BLOCK_SIZE, end - run));
+    }
+}
+
+template <typename Policy, typename Terms>
+void InvertedIndex::Remove(const Policy& policy, const Terms& terms, int document_id) {
+    // Checked up front, an exception must not escape a parallel algorithm
+    for (TermId term : terms) {
+        Verify(term);
+    }
+    // Every term owns its own list, so they can be edited concurrently
+    std::for_each(policy, terms.begin(), terms.end(), [this, document_id](TermId term) {
+        if (term < postings_.size()) {
+            postings_[term].Remove(document_id);
+        }
+    });
+    for (TermId term : terms) {
+        if (term < postings_.size()) {
+            Refresh(term);
+        }
+    }
+}
+
+template <typename Policy, typename Terms>
+void InvertedIndex::Purge(const Policy& policy, const Terms& terms, const std::vector<bool>& removed) {
+    for (TermId term : terms) {
+        Verify(term);
+    }
+    std::for_each(policy, terms.begin(), terms.end(), [this, &removed](TermId term) {
+        if (term < postings_.size()) {
+            postings_[term].Purge(removed);
+        }
+    });
+    for (TermId term : terms) {
+        if (term < postings_.size()) {
+            Refresh(term);
+        }
+    }
+}
+
+template <typename Policy>
+void InvertedIndex::Renumber(const Policy& policy, const std::vector<int>& new_ids) {
+    for (TermId term = 0; term < postings_.size(); ++term) {
+        Verify(term);
+    }
+    std::for_each(policy, postings_.begin(), postings_.end(), [&new_ids](PostingList& postings) {
+        postings.Renumber(new_ids);
+    });
+    for (TermId term = 0; term < postings_.size(); ++term) {
+        Refresh(term);
+    }
+}
@@ -1 +1,39 @@
-#pragma once
\ No newline at end of file
+#pragma once
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
+#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
+#define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
+#define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
+#define LOG_DURATION_STREAM(x, y) LogDuration UNIQUE_VAR_NAME_PROFILE(x, y)
+
+// Prints how long the enclosing scope took when it ends
+class LogDuration {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit LogDuration(std::string_view id, std::ostream& out = std::cerr)
+        : id_(id)
+        , out_(out) {
+    }
+
+    LogDuration(const LogDuration&) = delete;
+    LogDuration& operator=(const LogDuration&) = delete;
+
+    ~LogDuration() {
+        using namespace std::literals;
+        out_ << id_ << ": "s << std::chrono::duration_cast<std::chrono::milliseconds>(Elapsed()).count() << " ms"s << std::endl;
+    }
+
+    Clock::duration Elapsed() const {
+        return Clock::now() - start_time_;
+    }
+
+private:
+    const std::string id_;
+    std::ostream& out_;
+    const Clock::time_point start_time_ = Clock::now();
+};
@@ -0,0 +1,22 @@
+#include "memory_usage.h"
+
+size_t MemoryUsage::Total() const {
+    return posting_bytes + dictionary_bytes + forward_index_bytes + document_bytes;
+}
+
+double MemoryUsage::BytesPerPosting() const {
+    return posting_count == 0 ? 0.0 : static_cast<double>(posting_bytes) / posting_count;
+}
+
+std::ostream& operator<<(std::ostream& out, const MemoryUsage& usage) {
+    using namespace std;
+    out << "{ "s
+        << "postings = "s << usage.posting_count << ", "s
+        << "posting_bytes = "s << usage.posting_bytes << ", "s
+        << "bytes_per_posting = "s << usage.BytesPerPosting() << ", "s
+        << "dictionary_bytes = "s << usage.dictionary_bytes << ", "s
+        << "forward_index_bytes = "s << usage.forward_index_bytes << ", "s
+        << "document_bytes = "s << usage.document_bytes << ", "s
+        << "total_bytes = "s << usage.Total() << " }"s;
+    return out;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <iostream>
+
+// Approximate heap footprint of a SearchServer by structure, in bytes
+struct MemoryUsage {
+    size_t posting_count = 0;
+    size_t posting_bytes = 0;
+    size_t dictionary_bytes = 0;
+    size_t forward_index_bytes = 0;
+    size_t document_bytes = 0;
+
+    size_t Total() const;
+
+    double BytesPerPosting() const;
+};
+
+std::ostream& operator<<(std::ostream& out, const MemoryUsage& usage);
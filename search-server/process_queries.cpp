@@ -1,24 +1,19 @@
 #include "process_queries.h"
-#include <algorithm>
-#include <iterator>
-#include <execution>
+
+namespace {
+// Shared by all callers, so the worker threads are started once per process
+QueryEngine& GetQueryEngine() {
+    static QueryEngine engine;
+    return engine;
+}
+}
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> vector_return (queries.size());
-    std::transform(std::execution::par, queries.begin(),queries.cend(),vector_return.begin(), [&search_server](std::string words) {
-        return search_server.FindTopDocuments(words); 
-    });
-    return vector_return;
+    return GetQueryEngine().Process(search_server, queries);
 }
 
-std::list<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
-    std::list<Document> list_return;
-    for(auto doc : ProcessQueries(search_server, queries)) {
-        for(auto one_doc : doc) {
-            list_return.push_back(one_doc);
-        }
-    }
-    return list_return;   
-}
\ No newline at end of file
+QueryBatchResult ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    return GetQueryEngine().ProcessJoined(search_server, queries);
+}
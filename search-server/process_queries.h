@@ -1,8 +1,12 @@
 #pragma once
 #include <vector>
-#include <list>
 #include "document.h"
+#include "query_engine.h"
 #include "search_server.h"
+
+// Both run on one worker pool per process. Calls from several threads do not
+// wait for each other: a batch that finds the pool busy runs on execution::par
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
 
-std::list<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries); 
\ No newline at end of file
+// Documents of all queries in one buffer, in query order, with per-query offsets
+QueryBatchResult ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
@@ -0,0 +1,104 @@
+#include "query_cache.h"
+
+double QueryCacheStats::HitRate() const {
+    const uint64_t lookups = hits + misses;
+    return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+}
+
+bool QueryCache::Key::operator==(const Key& other) const {
+    return status == other.status && precision == other.precision && plus_terms == other.plus_terms && minus_terms == other.minus_terms;
+}
+
+size_t QueryCache::KeyHash::operator()(const Key& key) const {
+    uint64_t hash = 14695981039346656037ull ^ static_cast<uint64_t>(key.status) ^ static_cast<uint64_t>(key.precision) << 8;
+    auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 1099511628211ull;
+    };
+    for (TermId term : key.plus_terms) {
+        mix(term);
+    }
+    // Keeps {a} {} and {} {a} apart
+    mix(~0ull);
+    for (TermId term : key.minus_terms) {
+        mix(term);
+    }
+    return static_cast<size_t>(hash ^ (hash >> 29));
+}
+
+QueryCache::QueryCache(size_t capacity) {
+    SetCapacity(capacity);
+}
+
+QueryCache::QueryCache(const QueryCache& other)
+    : QueryCache(other.capacity_) {
+}
+
+QueryCache& QueryCache::operator=(const QueryCache& other) {
+    if (this != &other) {
+        SetCapacity(other.capacity_);
+    }
+    return *this;
+}
+
+void QueryCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    shard_capacity_ = (capacity + SHARD_COUNT - 1) / SHARD_COUNT;
+    shards_ = capacity == 0 ? nullptr : std::make_unique<Shard[]>(SHARD_COUNT);
+    hits_ = 0;
+    misses_ = 0;
+}
+
+QueryCache::Shard& QueryCache::GetShard(size_t hash) const {
+    return shards_[(hash >> 7) % SHARD_COUNT];
+}
+
+std::optional<std::vector<Document>> QueryCache::Find(const Key& key, uint64_t generation) {
+    if (capacity_ == 0) {
+        return std::nullopt;
+    }
+    Shard& shard = GetShard(KeyHash()(key));
+    std::lock_guard guard(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end() || it->second.generation != generation) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second.position);
+    return it->second.documents;
+}
+
+void QueryCache::Insert(const Key& key, uint64_t generation, const std::vector<Document>& documents) {
+    if (capacity_ == 0) {
+        return;
+    }
+    Shard& shard = GetShard(KeyHash()(key));
+    std::lock_guard guard(shard.mutex);
+    auto [it, inserted] = shard.entries.try_emplace(key);
+    Entry& entry = it->second;
+    if (inserted) {
+        shard.lru.push_front(&it->first);
+        entry.position = shard.lru.begin();
+    } else {
+        shard.lru.splice(shard.lru.begin(), shard.lru, entry.position);
+    }
+    entry.generation = generation;
+    entry.documents = documents;
+    while (shard.entries.size() > shard_capacity_) {
+        shard.entries.erase(*shard.lru.back());
+        shard.lru.pop_back();
+    }
+}
+
+QueryCacheStats QueryCache::GetStats() const {
+    QueryCacheStats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    if (shards_) {
+        for (size_t i = 0; i < SHARD_COUNT; ++i) {
+            std::lock_guard guard(shards_[i].mutex);
+            stats.size += shards_[i].entries.size();
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "document.h"
+#include "term_dictionary.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+struct QueryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // Live entries, stale ones included until they are evicted or looked up
+    size_t size = 0;
+
+    double HitRate() const;
+};
+
+// LRU cache of FindTopDocuments results keyed on the parsed query.
+// Entries carry the index generation they were computed at; an entry of an
+// older generation counts as a miss, so index updates need no explicit flush.
+// Lookups from concurrent readers are safe, the entries are split over
+// independently locked shards
+class QueryCache {
+public:
+    struct Key {
+        // Sorted and deduplicated
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+        DocumentStatus status;
+        // Relevance differs in the last digits between float and double scoring
+        ScorePrecision precision;
+
+        bool operator==(const Key& other) const;
+    };
+
+    // Capacity 0 disables the cache
+    explicit QueryCache(size_t capacity = 0);
+
+    // A copy starts empty, with the same capacity
+    QueryCache(const QueryCache& other);
+    QueryCache& operator=(const QueryCache& other);
+
+    // Drops all entries
+    void SetCapacity(size_t capacity);
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    std::optional<std::vector<Document>> Find(const Key& key, uint64_t generation);
+
+    void Insert(const Key& key, uint64_t generation, const std::vector<Document>& documents);
+
+    QueryCacheStats GetStats() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        uint64_t generation;
+        std::vector<Document> documents;
+        // Position in Shard::lru, most recently used first
+        std::list<const Key*>::iterator position;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Key, Entry, KeyHash> entries;
+        std::list<const Key*> lru;
+    };
+
+    size_t capacity_ = 0;
+    size_t shard_capacity_ = 0;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+
+    Shard& GetShard(size_t hash) const;
+};
@@ -0,0 +1,124 @@
+#include "query_engine.h"
+#include <algorithm>
+#include <exception>
+#include <execution>
+#include <numeric>
+
+QueryEngine::QueryEngine(size_t thread_count)
+    : ranges_(std::max<size_t>(1, thread_count)) {
+    // The submitting thread works as worker 0
+    for (size_t worker = 1; worker < ranges_.size(); ++worker) {
+        threads_.emplace_back([this, worker] {
+            WorkerLoop(worker);
+        });
+    }
+}
+
+QueryEngine::~QueryEngine() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+std::vector<std::vector<Document>> QueryEngine::Process(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    std::vector<std::vector<Document>> documents(queries.size());
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    ForEach(queries.size(), [&](size_t index) {
+        try {
+            documents[index] = search_server.FindTopDocuments(std::execution::seq, queries[index]);
+        } catch (...) {
+            std::lock_guard lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return documents;
+}
+
+QueryBatchResult QueryEngine::ProcessJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    // Joined once all sizes are known, so the buffer is sized by the actual results
+    const std::vector<std::vector<Document>> documents = Process(search_server, queries);
+    QueryBatchResult result;
+    result.offsets.assign(queries.size() + 1, 0);
+    for (size_t index = 0; index < queries.size(); ++index) {
+        result.offsets[index + 1] = result.offsets[index] + documents[index].size();
+    }
+    result.documents.reserve(result.offsets.back());
+    for (const std::vector<Document>& query_documents : documents) {
+        result.documents.insert(result.documents.end(), query_documents.begin(), query_documents.end());
+    }
+    return result;
+}
+
+void QueryEngine::ForEach(size_t count, const std::function<void(size_t)>& task) {
+    std::unique_lock batch_lock(batch_mutex_, std::try_to_lock);
+    if (!batch_lock.owns_lock()) {
+        // Another batch holds the pool
+        std::vector<size_t> indexes(count);
+        std::iota(indexes.begin(), indexes.end(), size_t{0});
+        std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&task](size_t index) {
+            task(index);
+        });
+        return;
+    }
+    const size_t worker_count = ranges_.size();
+    for (size_t worker = 0; worker < worker_count; ++worker) {
+        ranges_[worker].next.store(count * worker / worker_count, std::memory_order_relaxed);
+        ranges_[worker].end = count * (worker + 1) / worker_count;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        task_ = &task;
+        active_workers_ = threads_.size();
+        ++generation_;
+    }
+    wake_.notify_all();
+    Drain(0);
+    std::unique_lock lock(mutex_);
+    done_.wait(lock, [this] {
+        return active_workers_ == 0;
+    });
+    task_ = nullptr;
+}
+
+void QueryEngine::WorkerLoop(size_t worker) {
+    size_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock lock(mutex_);
+            wake_.wait(lock, [this, seen_generation] {
+                return stopping_ || generation_ != seen_generation;
+            });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+        }
+        Drain(worker);
+        std::lock_guard lock(mutex_);
+        if (--active_workers_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+void QueryEngine::Drain(size_t worker) {
+    const size_t worker_count = ranges_.size();
+    for (size_t step = 0; step < worker_count; ++step) {
+        WorkRange& range = ranges_[(worker + step) % worker_count];
+        // One index per claim: query costs vary too much for larger grains to pay off
+        for (size_t index = range.next.fetch_add(1); index < range.end; index = range.next.fetch_add(1)) {
+            (*task_)(index);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "document.h"
+#include "search_server.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Results of a batch in one contiguous buffer: the documents of query i
+// are documents[offsets[i], offsets[i + 1])
+struct QueryBatchResult {
+    std::vector<Document> documents;
+    std::vector<size_t> offsets;
+
+    size_t query_count() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    const Document* begin(size_t query) const {
+        return documents.data() + offsets[query];
+    }
+
+    const Document* end(size_t query) const {
+        return documents.data() + offsets[query + 1];
+    }
+
+    // All documents in query order
+    std::vector<Document>::const_iterator begin() const {
+        return documents.begin();
+    }
+
+    std::vector<Document>::const_iterator end() const {
+        return documents.end();
+    }
+};
+
+// Runs batches of queries on a pool of long-lived workers. Every worker starts
+// on its own slice of the batch and steals from the others once it is done,
+// so a few expensive queries do not leave the rest of the pool idle.
+// The pool runs one batch at a time; a batch submitted while it is busy runs
+// beside it on the standard parallel algorithms instead of waiting
+class QueryEngine {
+public:
+    explicit QueryEngine(size_t thread_count = std::thread::hardware_concurrency());
+
+    QueryEngine(const QueryEngine&) = delete;
+    QueryEngine& operator=(const QueryEngine&) = delete;
+
+    ~QueryEngine();
+
+    // FindTopDocuments for every query. Rethrows the first exception of a query
+    std::vector<std::vector<Document>> Process(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+    // Process with the results joined into one buffer
+    QueryBatchResult ProcessJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+    // Calls task(index) for every index in [0, count) and waits for all of them.
+    // The task must not throw and must not submit to the same engine
+    void ForEach(size_t count, const std::function<void(size_t)>& task);
+
+    size_t thread_count() const {
+        return ranges_.size();
+    }
+
+private:
+    // Unclaimed indexes of a worker's slice; both the owner and thieves claim from next
+    struct alignas(64) WorkRange {
+        std::atomic<size_t> next = 0;
+        size_t end = 0;
+    };
+
+    std::vector<WorkRange> ranges_;
+    std::vector<std::thread> threads_;
+
+    std::mutex batch_mutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t)>* task_ = nullptr;
+    size_t generation_ = 0;
+    size_t active_workers_ = 0;
+    bool stopping_ = false;
+
+    void WorkerLoop(size_t worker);
+
+    // Runs the own slice of the worker, then steals from the others
+    void Drain(size_t worker);
+};
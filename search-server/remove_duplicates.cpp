@@ -1,23 +1,170 @@
 #include "remove_duplicates.h"
+#include <numeric>
 #include <vector>
 
-void RemoveDuplicates(SearchServer& search_server){
- std::vector<std::pair<int, std::vector<string>>> id;
-   for(auto ids : search_server){
-       vector<string> words;
-       for(auto word : search_server.GetWordFrequencies(ids)) {
-           words.push_back(word.first);
-       }
-       id.push_back({ids,words});
-   }
-   
-   for(int i = 0; i < id.size(); ++i) {
-       for(auto i_2 = i+1; i_2 < id.size(); ++i_2) {
-           if(id[i_2].first > id[i].first && id[i].second == id[i_2].second) {
-               cout << "Found duplicate document id " << id[i_2].first << endl;
-                   search_server.RemoveDocument(id[i_2].first);
-           }
-       }
-   }
-
-}
\ No newline at end of file
+namespace {
+uint64_t Mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// Terms are sorted, so equal word sets give equal fingerprints
+uint64_t Fingerprint(const WordFrequencies& words) {
+    uint64_t fingerprint = Mix(words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        fingerprint = Mix(fingerprint ^ Mix(words.terms()[i]));
+    }
+    return fingerprint;
+}
+
+double JaccardSimilarity(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t common = 0;
+    for (size_t left = 0, right = 0; left < lhs.size() && right < rhs.size();) {
+        if (lhs.terms()[left] < rhs.terms()[right]) {
+            ++left;
+        } else if (rhs.terms()[right] < lhs.terms()[left]) {
+            ++right;
+        } else {
+            ++common;
+            ++left;
+            ++right;
+        }
+    }
+    return static_cast<double>(common) / (lhs.size() + rhs.size() - common);
+}
+
+bool HaveSameWords(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+    return lhs.size() == rhs.size() && equal(lhs.terms(), lhs.terms() + lhs.size(), rhs.terms());
+}
+
+// Calls f(first, last) for every run of equal keys in entries sorted by key
+template <typename Entry, typename Function>
+void ForEachGroup(const vector<Entry>& entries, Function f) {
+    for (size_t first = 0; first < entries.size();) {
+        size_t last = first + 1;
+        while (last < entries.size() && entries[last].first == entries[first].first) {
+            ++last;
+        }
+        if (last - first > 1) {
+            f(first, last);
+        }
+        first = last;
+    }
+}
+
+// Key of one LSH band: a hash of the band's rows of the MinHash signature
+uint64_t BandKey(const WordFrequencies& words, size_t band, size_t rows) {
+    uint64_t key = Mix(band);
+    for (size_t row = 0; row < rows; ++row) {
+        const uint64_t seed = Mix(band * rows + row + 1);
+        uint64_t min_hash = UINT64_MAX;
+        for (size_t i = 0; i < words.size(); ++i) {
+            min_hash = min(min_hash, Mix(Mix(words.terms()[i]) ^ seed));
+        }
+        key = Mix(key ^ min_hash);
+    }
+    return key;
+}
+}
+
+vector<int> FindDuplicates(const SearchServer& search_server, const DuplicateSearchOptions& options) {
+    if (!(options.jaccard_threshold > 0.0 && options.jaccard_threshold <= 1.0)) {
+        throw invalid_argument("Jaccard threshold must be in (0, 1]"s);
+    }
+    if (options.jaccard_threshold < 1.0 && (options.minhash_bands == 0 || options.minhash_rows == 0)) {
+        throw invalid_argument("MinHash needs at least one band and row"s);
+    }
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    vector<WordFrequencies> words(document_ids.size());
+    transform(execution::par, document_ids.begin(), document_ids.end(), words.begin(), [&search_server](int document_id) {
+        return search_server.GetWordFrequencies(document_id);
+    });
+    vector<size_t> indexes(document_ids.size());
+    iota(indexes.begin(), indexes.end(), size_t{0});
+
+    // Exact duplicates. Later stages only look at the first document of every word set
+    vector<pair<uint64_t, size_t>> keys(document_ids.size());
+    transform(execution::par, indexes.begin(), indexes.end(), keys.begin(), [&words](size_t index) {
+        return pair{ Fingerprint(words[index]), index };
+    });
+    sort(execution::par, keys.begin(), keys.end());
+    // Exact copies always go: whatever makes their original go applies to them too
+    vector<bool> is_removed(document_ids.size(), false);
+    ForEachGroup(keys, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            for (size_t j = i + 1; j < last && !is_removed[keys[i].second]; ++j) {
+                if (!is_removed[keys[j].second] && HaveSameWords(words[keys[i].second], words[keys[j].second])) {
+                    is_removed[keys[j].second] = true;
+                }
+            }
+        }
+    });
+    if (options.jaccard_threshold < 1.0) {
+        // Candidate pairs of document indexes, lower index first
+        vector<pair<size_t, size_t>> pairs;
+        vector<size_t> distinct;
+        copy_if(indexes.begin(), indexes.end(), back_inserter(distinct), [&is_removed](size_t index) {
+            return !is_removed[index];
+        });
+        // One band at a time keeps memory linear in the number of documents
+        for (size_t band = 0; band < options.minhash_bands; ++band) {
+            keys.resize(distinct.size());
+            transform(execution::par, distinct.begin(), distinct.end(), keys.begin(), [&](size_t index) {
+                return pair{ BandKey(words[index], band, options.minhash_rows), index };
+            });
+            sort(execution::par, keys.begin(), keys.end());
+            ForEachGroup(keys, [&pairs, &keys](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    for (size_t j = i + 1; j < last; ++j) {
+                        pairs.emplace_back(keys[i].second, keys[j].second);
+                    }
+                }
+            });
+        }
+        sort(execution::par, pairs.begin(), pairs.end());
+        pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+        vector<char> is_similar(pairs.size());
+        transform(execution::par, pairs.begin(), pairs.end(), is_similar.begin(), [&](const pair<size_t, size_t>& candidate) {
+            return JaccardSimilarity(words[candidate.first], words[candidate.second]) >= options.jaccard_threshold;
+        });
+        size_t kept = 0;
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            if (is_similar[i]) {
+                pairs[kept++] = pairs[i];
+            }
+        }
+        pairs.resize(kept);
+
+        // In id order, a document goes if it is similar to a lower one that stays
+        sort(pairs.begin(), pairs.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second < rhs.second;
+        });
+        for (const auto& [original, duplicate] : pairs) {
+            if (!is_removed[original]) {
+                is_removed[duplicate] = true;
+            }
+        }
+    }
+
+    vector<int> duplicates;
+    for (size_t index = 0; index < document_ids.size(); ++index) {
+        if (is_removed[index]) {
+            duplicates.push_back(document_ids[index]);
+        }
+    }
+    return duplicates;
+}
+
+void RemoveDuplicates(SearchServer& search_server, const DuplicateSearchOptions& options) {
+    const vector<int> duplicates = FindDuplicates(search_server, options);
+    for (int document_id : duplicates) {
+        cout << "Found duplicate document id " << document_id << endl;
+    }
+    // One batch marks the postings, compacting rewrites every touched list once
+    search_server.RemoveDocuments(execution::par, duplicates);
+    search_server.CompactIndex(execution::par);
+}
@@ -1,3 +1,22 @@
 #pragma once
 #include "search_server.h"
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+
+struct DuplicateSearchOptions {
+    // Documents whose word sets have at least this Jaccard similarity are duplicates.
+    // 1.0 matches only documents with exactly the same words
+    double jaccard_threshold = 1.0;
+    // Near duplicates are found with MinHash signatures of bands * rows hashes
+    // split into bands (LSH); more rows per band mean fewer, more similar candidates
+    size_t minhash_bands = 16;
+    size_t minhash_rows = 4;
+};
+
+// Ids of documents that duplicate a document with a lower id which is kept, ascending.
+// Exact duplicates are grouped by a fingerprint of the word set, near duplicates
+// by locality-sensitive hashing; every candidate pair is verified on the word sets.
+// Near-linear in the number of documents, runs in parallel
+vector<int> FindDuplicates(const SearchServer& search_server, const DuplicateSearchOptions& options = {});
+
+// Removes the documents FindDuplicates finds in one batch and compacts the index,
+// reporting each one to cout
+void RemoveDuplicates(SearchServer& search_server, const DuplicateSearchOptions& options = {});
@@ -0,0 +1,352 @@
+#include "score_accumulator.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SCORE_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// The kernels add scores like Add, one document at a time in posting order.
+// Floating point contraction would round a fused multiply-add differently from
+// the scalar kernel, so it is kept off
+#if defined(__GNUC__) && !defined(__clang__)
+#define SCORE_KERNEL_FLOAT_MODE __attribute__((optimize("fp-contract=off")))
+#else
+#define SCORE_KERNEL_FLOAT_MODE
+#endif
+
+// Helpers of the vector kernels must be inlined into them: a call into code compiled
+// without AVX, with the upper halves of the registers dirty, stalls on every SSE instruction
+#if defined(__GNUC__) || defined(__clang__)
+#define SCORE_KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define SCORE_KERNEL_INLINE inline
+#endif
+
+namespace {
+
+// Values of BasicScoreAccumulator::State
+constexpr uint8_t UNTOUCHED = 0;
+constexpr uint8_t SCORED = 1;
+constexpr uint8_t EXCLUDED = 2;
+
+// The arrays of an accumulator and the postings of one word. A kernel writes the
+// ids of documents it touches for the first time to touched and returns their count.
+// Kernels do not branch on the state of a document, the branch is mispredicted too
+// often: excluded documents are scored as well, ForEach never reports them and Clear
+// resets their scores
+template <typename Score>
+struct PostingRun {
+    const int* document_ids;
+    const uint32_t* term_counts;
+    size_t count;
+    const Score* inv_word_counts;
+    Score inverse_document_freq;
+    int first_document_id;
+    Score* scores;
+    uint8_t* state;
+    int* touched;
+};
+
+template <typename Score>
+SCORE_KERNEL_INLINE SCORE_KERNEL_FLOAT_MODE size_t AddPosting(const PostingRun<Score>& run, size_t i, Score score, size_t touched_count) {
+    const int document_id = run.document_ids[i];
+    const size_t index = document_id - run.first_document_id;
+    const uint8_t state = run.state[index];
+    run.touched[touched_count] = document_id;
+    touched_count += state == UNTOUCHED;
+    run.state[index] = std::max(state, SCORED);
+    run.scores[index] += score;
+    return touched_count;
+}
+
+template <typename Score>
+SCORE_KERNEL_INLINE SCORE_KERNEL_FLOAT_MODE size_t AddPostingsScalar(const PostingRun<Score>& run, size_t first, size_t last, size_t touched_count) {
+    for (size_t i = first; i < last; ++i) {
+        const Score score = static_cast<Score>(run.term_counts[i]) * run.inv_word_counts[run.document_ids[i]] * run.inverse_document_freq;
+        touched_count = AddPosting(run, i, score, touched_count);
+    }
+    return touched_count;
+}
+
+#if defined(SCORE_KERNELS_X86)
+
+// Postings of frequent words often cover consecutive documents. For a group of
+// lanes that does, scores and inverse word counts are loaded and stored as plain
+// vectors and the states are updated together. Scattered groups are added one
+// posting at a time: gathering and scattering them measured slower than that.
+// The kernels take the run by value, so that its fields stay in registers
+
+template <size_t LANES>
+SCORE_KERNEL_INLINE bool IsDenseGroup(const int* document_ids) {
+    return document_ids[LANES - 1] - document_ids[0] == static_cast<int>(LANES - 1);
+}
+
+// Marks the untouched documents of a dense group scored, returns them as a lane mask
+template <size_t LANES>
+SCORE_KERNEL_INLINE unsigned MarkDenseGroup(uint8_t* state) {
+    static_assert(LANES == 4 || LANES == 8 || LANES == 16);
+    __m128i states;
+    if constexpr (LANES == 16) {
+        states = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+    } else {
+        uint64_t word = 0;
+        std::memcpy(&word, state, LANES);
+        states = _mm_cvtsi64_si128(static_cast<long long>(word));
+    }
+    const unsigned untouched = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(states, _mm_setzero_si128()))) & ((1u << LANES) - 1);
+    states = _mm_max_epu8(states, _mm_set1_epi8(SCORED));
+    if constexpr (LANES == 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), states);
+    } else {
+        const uint64_t word = static_cast<uint64_t>(_mm_cvtsi128_si64(states));
+        std::memcpy(state, &word, LANES);
+    }
+    return untouched;
+}
+
+SCORE_KERNEL_INLINE size_t AppendTouched(const int* document_ids, unsigned lanes, int* touched, size_t touched_count) {
+    for (; lanes != 0; lanes &= lanes - 1) {
+        touched[touched_count++] = document_ids[__builtin_ctz(lanes)];
+    }
+    return touched_count;
+}
+
+__attribute__((target("avx2"))) SCORE_KERNEL_FLOAT_MODE
+size_t AddPostingsAvx2(PostingRun<double> run) {
+    const __m256d inverse_document_freq = _mm256_set1_pd(run.inverse_document_freq);
+    size_t touched_count = 0;
+    size_t i = 0;
+    for (; i + 4 <= run.count; i += 4) {
+        const int* document_ids = run.document_ids + i;
+        if (!IsDenseGroup<4>(document_ids)) {
+            touched_count = AddPostingsScalar(run, i, i + 4, touched_count);
+            continue;
+        }
+        const size_t index = document_ids[0] - run.first_document_id;
+        const __m256d term_counts = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(run.term_counts + i)));
+        const __m256d scores = _mm256_mul_pd(_mm256_mul_pd(term_counts, _mm256_loadu_pd(run.inv_word_counts + document_ids[0])), inverse_document_freq);
+        _mm256_storeu_pd(run.scores + index, _mm256_add_pd(_mm256_loadu_pd(run.scores + index), scores));
+        touched_count = AppendTouched(document_ids, MarkDenseGroup<4>(run.state + index), run.touched, touched_count);
+    }
+    return AddPostingsScalar(run, i, run.count, touched_count);
+}
+
+__attribute__((target("avx2"))) SCORE_KERNEL_FLOAT_MODE
+size_t AddPostingsAvx2(PostingRun<float> run) {
+    const __m256 inverse_document_freq = _mm256_set1_ps(run.inverse_document_freq);
+    size_t touched_count = 0;
+    size_t i = 0;
+    for (; i + 8 <= run.count; i += 8) {
+        const int* document_ids = run.document_ids + i;
+        if (!IsDenseGroup<8>(document_ids)) {
+            touched_count = AddPostingsScalar(run, i, i + 8, touched_count);
+            continue;
+        }
+        const size_t index = document_ids[0] - run.first_document_id;
+        const __m256 term_counts = _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(run.term_counts + i)));
+        const __m256 scores = _mm256_mul_ps(_mm256_mul_ps(term_counts, _mm256_loadu_ps(run.inv_word_counts + document_ids[0])), inverse_document_freq);
+        _mm256_storeu_ps(run.scores + index, _mm256_add_ps(_mm256_loadu_ps(run.scores + index), scores));
+        touched_count = AppendTouched(document_ids, MarkDenseGroup<8>(run.state + index), run.touched, touched_count);
+    }
+    return AddPostingsScalar(run, i, run.count, touched_count);
+}
+
+// AVX-512 doubles the lanes and appends the newly touched ids with a compress-store
+
+__attribute__((target("avx2,avx512f"))) SCORE_KERNEL_FLOAT_MODE
+size_t AddPostingsAvx512(PostingRun<double> run) {
+    const __m512d inverse_document_freq = _mm512_set1_pd(run.inverse_document_freq);
+    size_t touched_count = 0;
+    size_t i = 0;
+    for (; i + 8 <= run.count; i += 8) {
+        const int* document_ids = run.document_ids + i;
+        if (!IsDenseGroup<8>(document_ids)) {
+            touched_count = AddPostingsScalar(run, i, i + 8, touched_count);
+            continue;
+        }
+        const size_t index = document_ids[0] - run.first_document_id;
+        const __m512d term_counts = _mm512_maskz_cvtepu32_pd(0xFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(run.term_counts + i)));
+        const __m512d scores = _mm512_mul_pd(_mm512_mul_pd(term_counts, _mm512_loadu_pd(run.inv_word_counts + document_ids[0])), inverse_document_freq);
+        _mm512_storeu_pd(run.scores + index, _mm512_add_pd(_mm512_loadu_pd(run.scores + index), scores));
+        const __mmask16 untouched = static_cast<__mmask16>(MarkDenseGroup<8>(run.state + index));
+        _mm512_mask_compressstoreu_epi32(run.touched + touched_count, untouched, _mm512_maskz_loadu_epi32(0xFF, document_ids));
+        touched_count += __builtin_popcount(untouched);
+    }
+    return AddPostingsScalar(run, i, run.count, touched_count);
+}
+
+__attribute__((target("avx2,avx512f"))) SCORE_KERNEL_FLOAT_MODE
+size_t AddPostingsAvx512(PostingRun<float> run) {
+    const __m512 inverse_document_freq = _mm512_set1_ps(run.inverse_document_freq);
+    size_t touched_count = 0;
+    size_t i = 0;
+    for (; i + 16 <= run.count; i += 16) {
+        const int* document_ids = run.document_ids + i;
+        if (!IsDenseGroup<16>(document_ids)) {
+            touched_count = AddPostingsScalar(run, i, i + 16, touched_count);
+            continue;
+        }
+        const size_t index = document_ids[0] - run.first_document_id;
+        const __m512 term_counts = _mm512_maskz_cvtepu32_ps(0xFFFF, _mm512_loadu_si512(run.term_counts + i));
+        const __m512 scores = _mm512_mul_ps(_mm512_mul_ps(term_counts, _mm512_loadu_ps(run.inv_word_counts + document_ids[0])), inverse_document_freq);
+        _mm512_storeu_ps(run.scores + index, _mm512_add_ps(_mm512_loadu_ps(run.scores + index), scores));
+        const __mmask16 untouched = static_cast<__mmask16>(MarkDenseGroup<16>(run.state + index));
+        _mm512_mask_compressstoreu_epi32(run.touched + touched_count, untouched, _mm512_loadu_si512(document_ids));
+        touched_count += __builtin_popcount(untouched);
+    }
+    return AddPostingsScalar(run, i, run.count, touched_count);
+}
+
+#endif
+
+ScoreKernel DetectScoreKernel() {
+#if defined(SCORE_KERNELS_X86)
+    if (IsScoreKernelSupported(ScoreKernel::AVX512)) {
+        return ScoreKernel::AVX512;
+    }
+    if (IsScoreKernelSupported(ScoreKernel::AVX2)) {
+        return ScoreKernel::AVX2;
+    }
+#endif
+    return ScoreKernel::SCALAR;
+}
+
+std::atomic<ScoreKernel>& CurrentScoreKernel() {
+    static std::atomic<ScoreKernel> kernel{ DetectScoreKernel() };
+    return kernel;
+}
+
+template <typename Score>
+size_t AddPostings(const PostingRun<Score>& run) {
+    switch (GetScoreKernel()) {
+#if defined(SCORE_KERNELS_X86)
+    case ScoreKernel::AVX512:
+        return AddPostingsAvx512(run);
+    case ScoreKernel::AVX2:
+        return AddPostingsAvx2(run);
+#endif
+    default:
+        return AddPostingsScalar(run, 0, run.count, 0);
+    }
+}
+
+} // namespace
+
+ScoreKernel GetScoreKernel() {
+    return CurrentScoreKernel().load(std::memory_order_relaxed);
+}
+
+bool IsScoreKernelSupported(ScoreKernel kernel) {
+    switch (kernel) {
+    case ScoreKernel::SCALAR:
+        return true;
+#if defined(SCORE_KERNELS_X86)
+    case ScoreKernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case ScoreKernel::AVX512:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+void SetScoreKernel(ScoreKernel kernel) {
+    if (!IsScoreKernelSupported(kernel)) {
+        throw std::invalid_argument("Score kernel is not supported by the CPU");
+    }
+    CurrentScoreKernel().store(kernel, std::memory_order_relaxed);
+}
+
+template <typename Score>
+void BasicScoreAccumulator<Score>::Reserve(size_t document_id_bound, int first_document_id) {
+    first_document_id_ = first_document_id;
+    const size_t size = document_id_bound > static_cast<size_t>(first_document_id) ? document_id_bound - first_document_id : 0;
+    if (scores_.size() < size) {
+        scores_.resize(size, Score{});
+        state_.resize(size, UNTOUCHED);
+    }
+}
+
+template <typename Score>
+void BasicScoreAccumulator<Score>::AddPostings(const int* document_ids, const uint32_t* term_counts, size_t count,
+    const Score* inv_word_counts, Score inverse_document_freq) {
+    static_assert(UNTOUCHED == ::UNTOUCHED && SCORED == ::SCORED && EXCLUDED == ::EXCLUDED);
+    if (touched_.size() < touched_count_ + count) {
+        touched_.resize(std::max(touched_count_ + count, 2 * touched_.size()));
+    }
+    const PostingRun<Score> run{ document_ids, term_counts, count, inv_word_counts, inverse_document_freq,
+        first_document_id_, scores_.data(), reinterpret_cast<uint8_t*>(state_.data()), touched_.data() + touched_count_ };
+    touched_count_ += ::AddPostings(run);
+}
+
+template <typename Score>
+void BasicScoreAccumulator<Score>::Clear() {
+    for (size_t i = 0; i < touched_count_; ++i) {
+        const size_t index = touched_[i] - first_document_id_;
+        scores_[index] = Score{};
+        state_[index] = UNTOUCHED;
+    }
+    touched_count_ = 0;
+}
+
+template <typename Score>
+BasicScoreAccumulatorPool<Score>::Handle::Handle(BasicScoreAccumulatorPool& pool, std::unique_ptr<BasicScoreAccumulator<Score>> accumulator)
+    : pool_(&pool)
+    , accumulator_(std::move(accumulator)) {
+}
+
+template <typename Score>
+BasicScoreAccumulatorPool<Score>::Handle::~Handle() {
+    if (accumulator_) {
+        accumulator_->Clear();
+        pool_->Release(std::move(accumulator_));
+    }
+}
+
+template <typename Score>
+BasicScoreAccumulatorPool<Score>::BasicScoreAccumulatorPool(const BasicScoreAccumulatorPool&) {
+}
+
+template <typename Score>
+BasicScoreAccumulatorPool<Score>& BasicScoreAccumulatorPool<Score>::operator=(const BasicScoreAccumulatorPool&) {
+    return *this;
+}
+
+template <typename Score>
+typename BasicScoreAccumulatorPool<Score>::Handle BasicScoreAccumulatorPool<Score>::Acquire(size_t document_id_bound, int first_document_id) {
+    std::unique_ptr<BasicScoreAccumulator<Score>> accumulator;
+    {
+        std::lock_guard guard(mutex_);
+        if (!free_.empty()) {
+            accumulator = std::move(free_.back());
+            free_.pop_back();
+        }
+    }
+    if (!accumulator) {
+        accumulator = std::make_unique<BasicScoreAccumulator<Score>>();
+    }
+    accumulator->Reserve(document_id_bound, first_document_id);
+    return Handle(*this, std::move(accumulator));
+}
+
+template <typename Score>
+void BasicScoreAccumulatorPool<Score>::Clear() {
+    std::lock_guard guard(mutex_);
+    free_.clear();
+}
+
+template <typename Score>
+void BasicScoreAccumulatorPool<Score>::Release(std::unique_ptr<BasicScoreAccumulator<Score>> accumulator) {
+    std::lock_guard guard(mutex_);
+    free_.push_back(std::move(accumulator));
+}
+
+template class BasicScoreAccumulator<double>;
+template class BasicScoreAccumulator<float>;
+template class BasicScoreAccumulatorPool<double>;
+template class BasicScoreAccumulatorPool<float>;
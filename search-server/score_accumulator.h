@@ -0,0 +1,146 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Instruction sets AddPostings can run on. The best one the CPU supports is
+// picked on first use; every kernel adds up exactly the same scores
+enum class ScoreKernel {
+    SCALAR,
+    AVX2,
+    AVX512,
+};
+
+ScoreKernel GetScoreKernel();
+
+bool IsScoreKernelSupported(ScoreKernel kernel);
+
+// Switches all accumulators to the kernel, e.g. to check a vector kernel against
+// the scalar one. Throws invalid_argument if the CPU does not support it
+void SetScoreKernel(ScoreKernel kernel);
+
+// Relevance accumulator indexed directly by document id, relative to the
+// first id of its range. Only touched documents are visited and reset, so
+// a warm accumulator scores a query without allocating.
+// Score is double, or float to halve the memory scoring goes through
+template <typename Score>
+class BasicScoreAccumulator {
+public:
+    // Makes ids in [first_document_id, document_id_bound) addressable; must be empty
+    void Reserve(size_t document_id_bound, int first_document_id = 0);
+
+    void Add(int document_id, Score relevance) {
+        const size_t index = document_id - first_document_id_;
+        if (state_[index] == UNTOUCHED) {
+            state_[index] = SCORED;
+            Touch(document_id);
+        }
+        scores_[index] += relevance;
+    }
+
+    // Adds term_counts[i] * inv_word_counts[document_ids[i]] * inverse_document_freq
+    // to every document but the excluded ones, like Add would. The ids must be ascending
+    // and distinct, as in the postings of one word: the vector kernels spot runs of
+    // consecutive documents by their first and last id
+    void AddPostings(const int* document_ids, const uint32_t* term_counts, size_t count,
+        const Score* inv_word_counts, Score inverse_document_freq);
+
+    // The document is dropped from the result, whatever it scores
+    void Exclude(int document_id) {
+        const size_t index = document_id - first_document_id_;
+        if (state_[index] == UNTOUCHED) {
+            Touch(document_id);
+        }
+        state_[index] = EXCLUDED;
+    }
+
+    bool IsExcluded(int document_id) const {
+        return state_[document_id - first_document_id_] == EXCLUDED;
+    }
+
+    // Calls f(document_id, relevance) for every scored, not excluded document
+    template <typename Function>
+    void ForEach(Function f) const {
+        for (size_t i = 0; i < touched_count_; ++i) {
+            const size_t index = touched_[i] - first_document_id_;
+            if (state_[index] == SCORED) {
+                f(touched_[i], scores_[index]);
+            }
+        }
+    }
+
+    void Clear();
+
+private:
+    enum State : uint8_t {
+        UNTOUCHED,
+        SCORED,
+        EXCLUDED,
+    };
+
+    int first_document_id_ = 0;
+    std::vector<Score> scores_;
+    std::vector<State> state_;
+    // The first touched_count_ entries are used; the rest is room for the kernels to write to
+    std::vector<int> touched_;
+    size_t touched_count_ = 0;
+
+    void Touch(int document_id) {
+        if (touched_count_ == touched_.size()) {
+            touched_.resize(std::max<size_t>(64, 2 * touched_.size()));
+        }
+        touched_[touched_count_++] = document_id;
+    }
+};
+
+using ScoreAccumulator = BasicScoreAccumulator<double>;
+using FloatScoreAccumulator = BasicScoreAccumulator<float>;
+
+// Hands out cleared accumulators and takes them back, so their buffers
+// are reused across queries and threads
+template <typename Score>
+class BasicScoreAccumulatorPool {
+public:
+    class Handle {
+    public:
+        Handle(BasicScoreAccumulatorPool& pool, std::unique_ptr<BasicScoreAccumulator<Score>> accumulator);
+        Handle(Handle&& other) = default;
+        Handle& operator=(Handle&& other) = delete;
+        ~Handle();
+
+        BasicScoreAccumulator<Score>& operator*() const {
+            return *accumulator_;
+        }
+
+        BasicScoreAccumulator<Score>* operator->() const {
+            return accumulator_.get();
+        }
+
+    private:
+        BasicScoreAccumulatorPool* pool_;
+        std::unique_ptr<BasicScoreAccumulator<Score>> accumulator_;
+    };
+
+    BasicScoreAccumulatorPool() = default;
+
+    // A copy shares nothing with the original and starts cold
+    BasicScoreAccumulatorPool(const BasicScoreAccumulatorPool&);
+    BasicScoreAccumulatorPool& operator=(const BasicScoreAccumulatorPool&);
+
+    // Covers ids in [first_document_id, document_id_bound)
+    Handle Acquire(size_t document_id_bound, int first_document_id = 0);
+
+    // Frees the idle accumulators, e.g. once ids have been renumbered into a smaller range
+    void Clear();
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<BasicScoreAccumulator<Score>>> free_;
+
+    void Release(std::unique_ptr<BasicScoreAccumulator<Score>> accumulator);
+};
+
+using ScoreAccumulatorPool = BasicScoreAccumulatorPool<double>;
+using FloatScoreAccumulatorPool = BasicScoreAccumulatorPool<float>;
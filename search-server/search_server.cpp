@@ -1,28 +1,219 @@
 #include "search_server.h"
+#include <cstring>
+#include <exception>
 #include <numeric>
+#include <unordered_map>
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
-       if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+       if ((document_id < 0) || document_slots_.count(document_id) > 0) {
             throw invalid_argument("Invalid document_id"s);
         }
         const auto words = SplitIntoWordsNoStop(document);
-        set<string_view> words_;
         const double inv_word_count = 1.0 / words.size();
+        map<TermId, uint32_t> term_counts;
         for (auto word : words) {
-            all_words.push_back(string(word));
-            word_to_document_freqs_[string_view(all_words.back())][document_id] += inv_word_count;
-            document_id_word_freqs_[document_id][string_view(all_words.back())] += inv_word_count;
-            words_.emplace(string_view(all_words.back()));
+            ++term_counts[dictionary_.Intern(word)];
+        }
+        // Posting lists of a loaded snapshot are checked before anything changes,
+        // so that a corrupted one leaves the server as it was
+        for (const auto& [term, term_count] : term_counts) {
+            word_to_document_freqs_.Find(term);
+        }
+        // Every term goes to its posting list once, with its count in the document.
+        // The new slot is the highest, so postings are appended
+        const int slot = AddDocumentSlot(document_id);
+        for (const auto [term, term_count] : term_counts) {
+            word_to_document_freqs_.Add(term, slot, term_count, term_count * inv_word_count);
+            word_to_document_freqs_.Refresh(term);
+        }
+        if (has_forward_index_) {
+            forward_index_.Add(slot, vector<pair<TermId, uint32_t>>(term_counts.begin(), term_counts.end()));
         }
     
-        documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
-        document_ids_.insert(document_id);
+        documents_.Add(slot, ComputeAverageRating(ratings), status, inv_word_count);
+        OnIndexChanged();
 }
  
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
-        return FindTopDocuments(execution::seq,raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
+void SearchServer::AddDocuments(const vector<DocumentInput>& documents) {
+        AddDocumentBatch(execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(const execution::sequenced_policy&, const vector<DocumentInput>& documents) {
+        AddDocumentBatch(execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(const execution::parallel_policy&, const vector<DocumentInput>& documents) {
+        AddDocumentBatch(execution::par, documents);
+}
+
+namespace {
+// Documents of one slice of a batch, tokenised without touching the server.
+// Words get local ids so that threads do not share the dictionary
+struct PartialIndex {
+    struct Posting {
+        int slot;
+        uint32_t term_count;
+        double term_freq;
+    };
+
+    struct PendingDocument {
+        int id;
+        int slot;
+        int rating;
+        DocumentStatus status;
+        double inv_word_count;
+        // Local word ids with their counts, turned into sorted terms when merging
+        vector<pair<uint32_t, uint32_t>> terms;
+    };
+
+    unordered_map<string_view, uint32_t> word_ids;
+    vector<string_view> words;
+    // By local word id, in slot order
+    vector<vector<Posting>> postings;
+    vector<PendingDocument> documents;
+    // Dictionary ids of words, filled in when merging
+    vector<TermId> terms;
+    exception_ptr error;
+};
+}
+
+template <typename Policy>
+void SearchServer::AddDocumentBatch(const Policy& policy, const vector<DocumentInput>& documents) {
+        // Ids are checked up front, so a failing batch leaves the server unchanged
+        vector<const DocumentInput*> sorted(documents.size());
+        transform(documents.begin(), documents.end(), sorted.begin(), [](const DocumentInput& document) {
+            return &document;
+        });
+        sort(sorted.begin(), sorted.end(), [](const DocumentInput* lhs, const DocumentInput* rhs) {
+            return lhs->id < rhs->id;
+        });
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            const int document_id = sorted[i]->id;
+            if (document_id < 0 || document_slots_.count(document_id) > 0 || (i > 0 && sorted[i - 1]->id == document_id)) {
+                throw invalid_argument("Invalid document_id"s);
+            }
+        }
+
+        // Documents get the next slots in id order. Slices are contiguous in slot order,
+        // so merged posting lists are appended to
+        const int first_slot = static_cast<int>(slot_document_ids_.size());
+        const size_t slice_count = max<size_t>(1, min<size_t>(sorted.size(), thread::hardware_concurrency() * 4));
+        vector<PartialIndex> slices(slice_count);
+        for_each(policy, slices.begin(), slices.end(), [&](PartialIndex& slice) {
+            const size_t index = &slice - slices.data();
+            try {
+                vector<uint32_t> counts;
+                vector<uint32_t> touched;
+                for (size_t i = index * sorted.size() / slice_count; i < (index + 1) * sorted.size() / slice_count; ++i) {
+                    const DocumentInput& input = *sorted[i];
+                    const auto words = SplitIntoWordsNoStop(input.text);
+                    const double inv_word_count = 1.0 / words.size();
+                    for (string_view word : words) {
+                        auto [it, inserted] = slice.word_ids.emplace(word, static_cast<uint32_t>(slice.words.size()));
+                        if (inserted) {
+                            slice.words.push_back(word);
+                            slice.postings.emplace_back();
+                            counts.push_back(0);
+                        }
+                        if (counts[it->second]++ == 0) {
+                            touched.push_back(it->second);
+                        }
+                    }
+                    auto& document = slice.documents.emplace_back();
+                    const int slot = first_slot + static_cast<int>(i);
+                    document = { input.id, slot, ComputeAverageRating(input.ratings), input.status, inv_word_count, {} };
+                    document.terms.reserve(touched.size());
+                    for (uint32_t word : touched) {
+                        slice.postings[word].push_back({ slot, counts[word], counts[word] * inv_word_count });
+                        document.terms.emplace_back(word, counts[word]);
+                        counts[word] = 0;
+                    }
+                    touched.clear();
+                }
+            } catch (...) {
+                slice.error = current_exception();
+            }
+        });
+        for (const PartialIndex& slice : slices) {
+            if (slice.error) {
+                rethrow_exception(slice.error);
+            }
+        }
+
+        // Interning is the only serial step, one lookup per distinct word of a slice
+        // Term, slice, local word id
+        vector<tuple<TermId, uint32_t, uint32_t>> sources;
+        for (uint32_t index = 0; index < slice_count; ++index) {
+            PartialIndex& slice = slices[index];
+            slice.terms.reserve(slice.words.size());
+            for (uint32_t word = 0; word < slice.words.size(); ++word) {
+                slice.terms.push_back(dictionary_.Intern(slice.words[word]));
+                sources.emplace_back(slice.terms.back(), index, word);
+            }
+        }
+        // Grouped by term, slices of a term stay in slot order
+        sort(sources.begin(), sources.end());
+        vector<pair<size_t, size_t>> groups;
+        for (size_t first = 0; first < sources.size();) {
+            size_t last = first + 1;
+            while (last < sources.size() && get<0>(sources[last]) == get<0>(sources[first])) {
+                ++last;
+            }
+            groups.emplace_back(first, last);
+            first = last;
+        }
+
+        // An exception escaping a parallel algorithm terminates, so posting lists
+        // of a loaded snapshot are checked first
+        for (pair<size_t, size_t> group : groups) {
+            word_to_document_freqs_.Find(get<0>(sources[group.first]));
+        }
+        word_to_document_freqs_.Reserve(dictionary_.size());
+        for_each(policy, groups.begin(), groups.end(), [&](pair<size_t, size_t> group) {
+            for (size_t i = group.first; i < group.second; ++i) {
+                const auto [term, index, word] = sources[i];
+                for (const auto& posting : slices[index].postings[word]) {
+                    word_to_document_freqs_.Add(term, posting.slot, posting.term_count, posting.term_freq);
+                }
+            }
         });
+        for (pair<size_t, size_t> group : groups) {
+            word_to_document_freqs_.Refresh(get<0>(sources[group.first]));
+        }
+        if (has_forward_index_) {
+            for_each(policy, slices.begin(), slices.end(), [](PartialIndex& slice) {
+                for (auto& document : slice.documents) {
+                    for (auto& [word, term_count] : document.terms) {
+                        word = slice.terms[word];
+                    }
+                    sort(document.terms.begin(), document.terms.end());
+                }
+            });
+        }
+
+        for (PartialIndex& slice : slices) {
+            for (auto& document : slice.documents) {
+                AddDocumentSlot(document.id);
+                if (has_forward_index_) {
+                    forward_index_.Add(document.slot, document.terms);
+                }
+                documents_.Add(document.slot, document.rating, document.status, document.inv_word_count);
+            }
+        }
+        OnIndexChanged();
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
+        return FindTopDocuments(execution::seq,raw_query, status);
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const DocumentFilter& filter) const {
+        return FindTopDocuments(execution::seq, raw_query, filter);
+}
+
+vector<uint64_t>& SearchServer::SelectedDocuments() {
+        static thread_local vector<uint64_t> selected;
+        return selected;
 }
  
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
@@ -32,34 +223,284 @@ vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
 int SearchServer::GetDocumentCount() const {
         return documents_.size();
 }
- 
-const std::set<int>::iterator SearchServer::begin() const {
-        return document_ids_.begin();
+
+void SearchServer::SetMaxResultDocumentCount(size_t count) {
+        max_result_document_count_ = count;
+        OnIndexChanged();
+}
+
+size_t SearchServer::GetMaxResultDocumentCount() const {
+        return max_result_document_count_;
+}
+
+void SearchServer::SetQueryCacheCapacity(size_t capacity) {
+        query_cache_.SetCapacity(capacity);
+}
+
+QueryCacheStats SearchServer::GetQueryCacheStats() const {
+        return query_cache_.GetStats();
+}
+
+void SearchServer::SetScorePrecision(ScorePrecision precision) {
+        score_precision_ = precision;
+        OnIndexChanged();
+}
+
+ScorePrecision SearchServer::GetScorePrecision() const {
+        return score_precision_;
+}
+
+void SearchServer::CompressIndex() {
+        word_to_document_freqs_.Compress();
+}
+
+namespace {
+// Color, parent and two children pointers of a std::map/std::set node
+constexpr size_t TREE_NODE_OVERHEAD = 4 * sizeof(void*);
+}
+
+MemoryUsage SearchServer::GetMemoryUsage() const {
+        MemoryUsage usage;
+        usage.posting_count = word_to_document_freqs_.posting_count();
+        usage.posting_bytes = word_to_document_freqs_.memory_usage();
+        usage.dictionary_bytes = dictionary_.memory_usage();
+        usage.forward_index_bytes = forward_index_.memory_usage();
+        usage.document_bytes = documents_.memory_usage() + slot_document_ids_.capacity() * sizeof(int)
+            + document_slots_.size() * (sizeof(*document_slots_.begin()) + TREE_NODE_OVERHEAD);
+        return usage;
 }
  
-const std::set<int>::iterator SearchServer::end() const {
-        return document_ids_.end();
+void SearchServer::SaveIndex(const string& path) const {
+        using namespace index_snapshot;
+        Writer writer;
+        FileHeader header{};
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.byte_order = BYTE_ORDER_MARK;
+        header.max_result_document_count = max_result_document_count_;
+        header.document_count = documents_.size();
+        header.slot_count = slot_document_ids_.size();
+        header.term_count = dictionary_.size();
+        writer.Write(header);
+
+        header.stop_words.offset = writer.WriteStrings(vector<string_view>(stop_words_.begin(), stop_words_.end()));
+        header.stop_words.size = writer.size() - header.stop_words.offset;
+
+        // Slots are kept, posting lists are written as they are
+        vector<DocumentRecord> documents;
+        documents.reserve(documents_.size());
+        for (int slot = 0; slot < static_cast<int>(slot_document_ids_.size()); ++slot) {
+            if (documents_.Contains(slot)) {
+                documents.push_back({ slot_document_ids_[slot], documents_.rating(slot), static_cast<int32_t>(documents_.status(slot)), slot,
+                    documents_.inv_word_count(slot) });
+            }
+        }
+        header.documents.offset = writer.Write(documents.data(), documents.size());
+        header.documents.size = writer.size() - header.documents.offset;
+
+        vector<string_view> words(dictionary_.size());
+        for (TermId term = 0; term < words.size(); ++term) {
+            words[term] = dictionary_.GetWord(term);
+        }
+        header.terms.offset = writer.WriteStrings(words);
+        header.terms.size = writer.size() - header.terms.offset;
+
+        // Records are filled in as the blocks behind them are written
+        header.postings.offset = writer.Write(vector<PostingRecord>(words.size()).data(), words.size());
+        for (TermId term = 0; term < words.size(); ++term) {
+            const PostingList* postings = word_to_document_freqs_.Find(term);
+            if (postings == nullptr) {
+                continue;
+            }
+            CompressedPostings packed;
+            const CompressedPostings* compressed = postings->compressed();
+            // Postings of removed documents are left out
+            if (compressed == nullptr || postings->removed_count() > 0) {
+                vector<int> slots;
+                vector<uint32_t> term_counts;
+                postings->ForEach([&](int slot, uint32_t term_count) {
+                    if (!IsRemoved(slot)) {
+                        slots.push_back(slot);
+                        term_counts.push_back(term_count);
+                    }
+                });
+                packed = CompressedPostings(slots.data(), term_counts.data(), slots.size());
+                compressed = &packed;
+            }
+            PostingRecord record{};
+            record.blocks_offset = writer.Write(compressed->blocks(), compressed->block_count());
+            writer.Align();
+            record.data_offset = writer.Write(compressed->data(), compressed->data_size());
+            writer.Align();
+            record.block_count = compressed->block_count();
+            record.data_size = compressed->data_size();
+            record.size = compressed->size();
+            record.max_term_freq = postings->max_term_freq();
+            record.checksum = writer.Checksum(record.blocks_offset, PostingExtent(record));
+            writer.At<PostingRecord>(header.postings.offset + term * sizeof(PostingRecord)) = record;
+        }
+        header.postings.size = writer.size() - header.postings.offset;
+
+        writer.At<FileHeader>(0) = header;
+        writer.Save(path);
+}
+
+SearchServer SearchServer::LoadIndex(const string& path, bool build_forward_index) {
+        using namespace index_snapshot;
+        auto file = MappedFile::Open(path);
+        const Reader reader(*file);
+        const FileHeader& header = reader.header();
+
+        SearchServer server(reader.GetStrings(header.stop_words));
+        server.snapshot_ = file;
+        server.max_result_document_count_ = header.max_result_document_count;
+
+        // Slots of documents removed before saving stay unused
+        if (header.slot_count < header.document_count || header.slot_count > static_cast<uint64_t>(INT_MAX)) {
+            throw runtime_error("Index file is corrupted"s);
+        }
+        server.slot_document_ids_.assign(header.slot_count, -1);
+        const DocumentRecord* documents = reader.Get<DocumentRecord>(header.documents.offset, header.document_count);
+        for (uint64_t i = 0; i < header.document_count; ++i) {
+            const DocumentRecord& record = documents[i];
+            if (record.document_id < 0 || record.status < 0 || record.status > static_cast<int32_t>(DocumentStatus::REMOVED)
+                || record.slot < 0 || static_cast<uint64_t>(record.slot) >= header.slot_count || (i > 0 && record.slot <= documents[i - 1].slot)
+                || !server.document_slots_.emplace(record.document_id, record.slot).second) {
+                throw runtime_error("Index file is corrupted"s);
+            }
+            server.slot_document_ids_[record.slot] = record.document_id;
+            server.documents_.Add(record.slot, record.rating, static_cast<DocumentStatus>(record.status), record.inv_word_count);
+        }
+        // Posting lists may refer to any slot below slot_count
+        server.documents_.Reserve(header.slot_count);
+
+        const auto words = reader.GetStrings(header.terms);
+        if (words.size() != header.term_count) {
+            throw runtime_error("Index file is corrupted"s);
+        }
+        for (string_view word : words) {
+            if (server.dictionary_.InternExternal(word) + 1 != server.dictionary_.size()) {
+                throw runtime_error("Index file is corrupted"s);
+            }
+        }
+
+        // Only the records are checked here, the blocks are checked when a list is first used
+        const PostingRecord* records = reader.Get<PostingRecord>(header.postings.offset, header.term_count);
+        for (TermId term = 0; term < header.term_count; ++term) {
+            const PostingRecord& record = records[term];
+            if (record.size == 0) {
+                continue;
+            }
+            const auto* blocks = reader.Get<CompressedPostings::BlockHeader>(record.blocks_offset, record.block_count);
+            const auto* data = reader.Get<uint32_t>(record.data_offset, record.data_size);
+            if (record.block_count != (record.size + CompressedPostings::BLOCK_SIZE - 1) / CompressedPostings::BLOCK_SIZE
+                || record.data_offset < record.blocks_offset + record.block_count * sizeof(CompressedPostings::BlockHeader)) {
+                throw runtime_error("Index file is corrupted"s);
+            }
+            auto compressed = CompressedPostings::View(blocks, record.block_count, data, record.data_size, record.size);
+            server.word_to_document_freqs_.Set(term, PostingList(move(compressed), record.max_term_freq));
+        }
+        server.word_to_document_freqs_.SetVerifier(make_shared<PostingVerifier>(file, records, header.term_count, header.slot_count));
+
+        // The forward index is not stored, it is rebuilt from the posting lists without re-tokenising
+        if (build_forward_index) {
+            server.BuildForwardIndex();
+        } else {
+            server.DropForwardIndex();
+        }
+        server.OnIndexChanged();
+        return server;
 }
 
-const std::map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const{
-    static map<string_view, double> empty_dictionary{};
-    if (document_id_word_freqs_.count(document_id) != 0){
-    return document_id_word_freqs_.at(document_id);}
+SearchServer::DocumentIdIterator SearchServer::begin() const {
+        return DocumentIdIterator(document_slots_.begin());
+}
  
-     return empty_dictionary;
+SearchServer::DocumentIdIterator SearchServer::end() const {
+        return DocumentIdIterator(document_slots_.end());
+}
+
+void SearchServer::DropForwardIndex() {
+        forward_index_.Clear();
+        has_forward_index_ = false;
+}
+
+void SearchServer::BuildForwardIndex() {
+        forward_index_.Build(slot_document_ids_.size(), [this](auto f) {
+            for (TermId term = 0; term < dictionary_.size(); ++term) {
+                if (const PostingList* postings = word_to_document_freqs_.Find(term)) {
+                    postings->ForEach([this, term, &f](int slot, uint32_t term_count) {
+                        if (!IsRemoved(slot)) {
+                            f(term, slot, term_count);
+                        }
+                    });
+                }
+            }
+        });
+        has_forward_index_ = true;
+}
+
+bool SearchServer::HasForwardIndex() const {
+        return has_forward_index_;
+}
+
+template <typename Function>
+void SearchServer::ForEachDocumentTerm(int slot, Function f) const {
+        if (has_forward_index_) {
+            const ForwardIndex::Entry entry = forward_index_.Get(slot);
+            for (size_t i = 0; i < entry.size; ++i) {
+                f(entry.terms[i], entry.term_counts[i]);
+            }
+            return;
+        }
+        for (TermId term = 0; term < dictionary_.size(); ++term) {
+            const PostingList* postings = word_to_document_freqs_.Find(term);
+            if (postings == nullptr) {
+                continue;
+            }
+            if (const uint32_t term_count = postings->TermCount(slot)) {
+                f(term, term_count);
+            }
+        }
+}
+
+bool SearchServer::DocumentHasTerm(int slot, TermId term) const {
+        if (has_forward_index_) {
+            return forward_index_.Contains(slot, term);
+        }
+        const PostingList* postings = word_to_document_freqs_.Find(term);
+        return postings != nullptr && postings->Contains(slot);
 }
  
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    const auto slot = FindDocumentSlot(document_id);
+    if (!slot) {
+        return {};
+    }
+    const double inv_word_count = documents_.inv_word_count(*slot);
+    if (has_forward_index_) {
+        return WordFrequencies(dictionary_, forward_index_.Get(*slot), inv_word_count);
+    }
+    // Gathered from the posting lists into storage the view keeps alive
+    auto terms = make_shared<pair<vector<TermId>, vector<uint32_t>>>();
+    ForEachDocumentTerm(*slot, [&terms](TermId term, uint32_t term_count) {
+        terms->first.push_back(term);
+        terms->second.push_back(term_count);
+    });
+    const ForwardIndex::Entry entry{ terms->first.data(), terms->second.data(), terms->first.size() };
+    return WordFrequencies(dictionary_, entry, inv_word_count, move(terms));
+}
+
 void SearchServer::RemoveDocument(int document_id) {
- 
-    for(auto word : GetWordFrequencies(document_id)) {
-        word_to_document_freqs_.at(word.first).erase(document_id);
-        if(word_to_document_freqs_.at(word.first).empty()) {
-            word_to_document_freqs_.erase(word.first);
-        }
+    const auto slot = FindDocumentSlot(document_id);
+    if (!slot) {
+        return;
     }
-    document_ids_.erase(document_id);
-    document_id_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
+    ForEachDocumentTerm(*slot, [this, slot](TermId term, uint32_t) {
+        word_to_document_freqs_.Remove(term, *slot);
+    });
+    EraseDocument(document_id, *slot);
+    OnIndexChanged();
 }
  
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id) {
@@ -67,43 +508,143 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int d
     }
  
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
- 
-    vector<string_view> to_delete(document_id_word_freqs_.at(document_id).size());
-    transform(execution::par,document_id_word_freqs_.at(document_id).begin(),document_id_word_freqs_.at(document_id).end(),to_delete.begin() , [](auto word_freq) {
-        return word_freq.first;
+    const auto slot = FindDocumentSlot(document_id);
+    if (!slot) {
+        return;
+    }
+    vector<TermId> terms;
+    ForEachDocumentTerm(*slot, [&terms](TermId term, uint32_t) {
+        terms.push_back(term);
     });
+    word_to_document_freqs_.Remove(execution::par, terms, *slot);
  
- for_each(execution::par, to_delete.begin(),to_delete.end(), [this,document_id](auto word) {
-      word_to_document_freqs_.at(word).erase(document_id);
- });
- 
-    document_ids_.erase(document_id);
-    document_id_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
+    EraseDocument(document_id, *slot);
+    OnIndexChanged();
 }
  
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
-    bool flag = true;
-        const auto query = ParseQuery(raw_query, flag);
- 
-        vector<string_view> matched_words;
-    for (auto word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+        RemoveDocumentBatch(execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const execution::sequenced_policy&, const vector<int>& document_ids) {
+        RemoveDocumentBatch(execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const execution::parallel_policy&, const vector<int>& document_ids) {
+        RemoveDocumentBatch(execution::par, document_ids);
+}
+
+template <typename Policy>
+void SearchServer::RemoveDocumentBatch(const Policy& policy, const vector<int>& document_ids) {
+        bool changed = false;
+        const size_t first_removed_term = removed_terms_.size();
+        for (int document_id : document_ids) {
+            const auto slot = FindDocumentSlot(document_id);
+            if (!slot) {
                 continue;
             }
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                return { matched_words, documents_.at(document_id).status };
+            if (static_cast<size_t>(*slot) >= removed_documents_.size()) {
+                removed_documents_.resize(*slot + 1);
             }
+            removed_documents_[*slot] = true;
+            ForEachDocumentTerm(*slot, [this](TermId term, uint32_t) {
+                word_to_document_freqs_.MarkRemoved(term);
+                removed_terms_.push_back(term);
+            });
+            EraseDocument(document_id, *slot);
+            changed = true;
         }
-        for (auto word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
+        if (!changed) {
+            return;
+        }
+        // Only the first call for a term computes its log
+        for (size_t i = first_removed_term; i < removed_terms_.size(); ++i) {
+            word_to_document_freqs_.Refresh(removed_terms_[i]);
+        }
+        if (removed_terms_.size() * 4 > word_to_document_freqs_.posting_count()) {
+            PurgeRemovedPostings(policy);
+        }
+        OnIndexChanged();
+}
+
+void SearchServer::CompactIndex() {
+        RenumberSlots(execution::seq);
+}
+
+void SearchServer::CompactIndex(const execution::sequenced_policy&) {
+        RenumberSlots(execution::seq);
+}
+
+void SearchServer::CompactIndex(const execution::parallel_policy&) {
+        RenumberSlots(execution::par);
+}
+
+template <typename Policy>
+void SearchServer::PurgeRemovedPostings(const Policy& policy) {
+        if (removed_terms_.empty()) {
+            return;
+        }
+        // Every list is rewritten once, however many of its documents went
+        sort(policy, removed_terms_.begin(), removed_terms_.end());
+        removed_terms_.erase(unique(removed_terms_.begin(), removed_terms_.end()), removed_terms_.end());
+        word_to_document_freqs_.Purge(policy, removed_terms_, removed_documents_);
+        vector<TermId>().swap(removed_terms_);
+        vector<bool>().swap(removed_documents_);
+}
+
+template <typename Policy>
+void SearchServer::RenumberSlots(const Policy& policy) {
+        if (GetDocumentSlotBound() == documents_.size()) {
+            return;
+        }
+        vector<int> new_slots(GetDocumentSlotBound(), -1);
+        vector<int> old_slots;
+        old_slots.reserve(documents_.size());
+        for (int slot = 0; slot < static_cast<int>(GetDocumentSlotBound()); ++slot) {
+            if (documents_.Contains(slot)) {
+                new_slots[slot] = static_cast<int>(old_slots.size());
+                old_slots.push_back(slot);
             }
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                matched_words.push_back(word);
+        }
+        // Checks snapshot lists before anything changes, so it goes first
+        word_to_document_freqs_.Renumber(policy, new_slots);
+
+        vector<int> slot_document_ids;
+        DocumentStore documents;
+        ForwardIndex forward_index;
+        slot_document_ids.reserve(old_slots.size());
+        documents.Reserve(old_slots.size());
+        vector<pair<TermId, uint32_t>> terms;
+        for (size_t slot = 0; slot < old_slots.size(); ++slot) {
+            const int old_slot = old_slots[slot];
+            slot_document_ids.push_back(slot_document_ids_[old_slot]);
+            documents.Add(static_cast<int>(slot), documents_.rating(old_slot), documents_.status(old_slot), documents_.inv_word_count(old_slot));
+            if (has_forward_index_) {
+                const ForwardIndex::Entry entry = forward_index_.Get(old_slot);
+                terms.clear();
+                for (size_t i = 0; i < entry.size; ++i) {
+                    terms.emplace_back(entry.terms[i], entry.term_counts[i]);
+                }
+                forward_index.Add(static_cast<int>(slot), terms);
             }
         }
-        return { matched_words, documents_.at(document_id).status };
+        for (auto& [document_id, slot] : document_slots_) {
+            slot = new_slots[slot];
+        }
+        slot_document_ids_.swap(slot_document_ids);
+        documents_ = move(documents);
+        forward_index_ = move(forward_index);
+        vector<TermId>().swap(removed_terms_);
+        vector<bool>().swap(removed_documents_);
+        // Pooled accumulators are sized for the old slot range
+        accumulators_.Clear();
+        float_accumulators_.Clear();
+        OnIndexChanged();
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
+        const QueryTerms query_terms = GetMatchTerms(*ParseQuery(raw_query, true));
+        return MatchQueryTerms(query_terms, GetDocumentSlot(document_id));
 }
  
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy&, string_view raw_query, int document_id) const {
@@ -111,38 +652,70 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const std
 }
  
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&, string_view raw_query, int document_id) const {
-      bool flag = false;
-        const auto query = ParseQuery(raw_query,flag);
-        vector<string_view> matched_words(query.plus_words.size());
- 
-    bool answer = any_of(execution::par, query.minus_words.begin(),query.minus_words.end(),[this,document_id](string_view minus_word) {
-    return word_to_document_freqs_.at(minus_word).count(document_id);   
-    });
- 
-    if(answer) {
-        matched_words.clear();
-        return { matched_words, documents_.at(document_id).status };
-    }
- 
-        auto last = copy_if(execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [this, document_id, &matched_words]( string_view word) {
-            if (word_to_document_freqs_.count(word) == 0) {
-               return false;
-            }
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                return true;
+        // A single document has too few words to split between threads
+        return SearchServer::MatchDocument(raw_query, document_id);
+}
+
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(string_view raw_query, const vector<int>& document_ids) const {
+        return MatchDocumentBatch(execution::seq, raw_query, document_ids);
+}
+
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(const execution::sequenced_policy&, string_view raw_query, const vector<int>& document_ids) const {
+        return MatchDocumentBatch(execution::seq, raw_query, document_ids);
+}
+
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(const execution::parallel_policy&, string_view raw_query, const vector<int>& document_ids) const {
+        return MatchDocumentBatch(execution::par, raw_query, document_ids);
+}
+
+template <typename Policy>
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocumentBatch(const Policy& policy, string_view raw_query, const vector<int>& document_ids) const {
+        const QueryTerms query_terms = GetMatchTerms(*ParseQuery(raw_query, true));
+        // An exception escaping a parallel algorithm terminates, so ids are resolved
+        // and posting lists of a loaded snapshot checked first
+        vector<int> slots(document_ids.size());
+        transform(document_ids.begin(), document_ids.end(), slots.begin(), [this](int document_id) {
+            return GetDocumentSlot(document_id);
+        });
+        for (const auto* terms : { &query_terms.plus_terms, &query_terms.minus_terms }) {
+            for (TermId term : *terms) {
+                word_to_document_freqs_.Find(term);
             }
-            return false;
-            });
- 
-    sort(matched_words.begin(),last);
-    auto del = unique(matched_words.begin(),last);
-    matched_words.erase(del,matched_words.end());
-    return { matched_words, documents_.at(document_id).status };
+        }
+        vector<tuple<vector<string_view>, DocumentStatus>> results(slots.size());
+        transform(policy, slots.begin(), slots.end(), results.begin(), [this, &query_terms](int slot) {
+            return MatchQueryTerms(query_terms, slot);
+        });
+        return results;
+}
 
+SearchServer::QueryTerms SearchServer::GetMatchTerms(const Query& query) const {
+        QueryTerms query_terms{ query.plus_terms, query.minus_terms };
+        // By word, so that the matched words come out sorted
+        sort(query_terms.plus_terms.begin(), query_terms.plus_terms.end(), [this](TermId lhs, TermId rhs) {
+            return dictionary_.GetWord(lhs) < dictionary_.GetWord(rhs);
+        });
+        return query_terms;
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchQueryTerms(const QueryTerms& query_terms, int slot) const {
+        const DocumentStatus status = documents_.status(slot);
+        vector<string_view> matched_words;
+        for (TermId term : query_terms.minus_terms) {
+            if (DocumentHasTerm(slot, term)) {
+                return { matched_words, status };
+            }
+        }
+        for (TermId term : query_terms.plus_terms) {
+            if (DocumentHasTerm(slot, term)) {
+                matched_words.push_back(dictionary_.GetWord(term));
+            }
+        }
+        return { matched_words, status };
 }
  
 bool SearchServer::IsStopWord(string_view word) const {
-        return stop_words_.count(word) > 0;
+        return stop_words_.Contains(word);
 }
  
 bool SearchServer::IsValidWord(string_view word) {
@@ -154,14 +727,14 @@ bool SearchServer::IsValidWord(string_view word) {
  
 vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
         vector<string_view> words;
-        for (auto word : SplitIntoWords(text)) {
-            if (!IsValidWord(word)) {
+        ForEachWord(text, [this, &words](string_view word, bool is_valid) {
+            if (!is_valid) {
                 throw invalid_argument("Word "s + std::string(word) + " is invalid");
             }
             if (!IsStopWord(word)) {
                 words.push_back(word);
             }
-        }
+        });
         return words;
 }
  
@@ -174,7 +747,7 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
         return rating_sum / static_cast<int>(ratings.size());
 }
  
-SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text, bool is_valid) const {
         if (text.empty()) {
             throw invalid_argument("Query word "s + std::string(text) + " empty"s);
         }
@@ -184,41 +757,138 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
             is_minus = true;
             word = word.substr(1);
         }
-        if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+        if (word.empty() || word[0] == '-' || !is_valid) {
             throw invalid_argument("Query word is invalid");
         }
  
         return { word, is_minus, IsStopWord(word) };
 }
  
-SearchServer::Query SearchServer::ParseQuery(string_view text, const bool& flag) const {
-        Query result;
-        for (auto word : SplitIntoWords(text)) {
-            const auto query_word = ParseQueryWord(word);
-            if (!query_word.is_stop) {
-                if (query_word.is_minus) {
-                    result.minus_words.push_back(query_word.data);
-                }
-                else {
-                    result.plus_words.push_back(query_word.data);
-                }
-            }
+vector<unique_ptr<SearchServer::Query>>& SearchServer::ParsedQuery::FreeQueries() {
+        // Cleared queries keep their capacity, so reusing them does not allocate
+        thread_local vector<unique_ptr<Query>> free_queries;
+        return free_queries;
+}
+
+SearchServer::ParsedQuery::ParsedQuery() {
+        auto& free_queries = FreeQueries();
+        if (free_queries.empty()) {
+            query_ = make_unique<Query>();
+        } else {
+            query_ = move(free_queries.back());
+            free_queries.pop_back();
         }
+}
+
+SearchServer::ParsedQuery::~ParsedQuery() {
+        if (query_ == nullptr) {
+            return;
+        }
+        query_->plus_terms.clear();
+        query_->minus_terms.clear();
+        FreeQueries().push_back(move(query_));
+}
+
+SearchServer::ParsedQuery SearchServer::ParseQuery(string_view text, const bool& flag) const {
+        ParsedQuery parsed;
+        Query& result = *parsed.query_;
+        ForEachWord(text, [this, &result](string_view word, bool is_valid) {
+            const auto query_word = ParseQueryWord(word, is_valid);
+            if (query_word.is_stop) {
+                return;
+            }
+            const auto term = dictionary_.Find(query_word.data);
+            if (!term) {
+                return;
+            }
+            if (query_word.is_minus) {
+                result.minus_terms.push_back(*term);
+            }
+            else {
+                result.plus_terms.push_back(*term);
+            }
+        });
  
         if(flag) {
-            sort(result.minus_words.begin(), result.minus_words.end());
-            sort(result.plus_words.begin(),result.plus_words.end());
-            auto last_1 = std::unique(result.minus_words.begin(), result.minus_words.end());
-            auto last_2 = std::unique(result.plus_words.begin(), result.plus_words.end());
-            result.minus_words.erase(last_1,result.minus_words.end());
-            result.plus_words.erase(last_2,result.plus_words.end());
+            sort(result.minus_terms.begin(), result.minus_terms.end());
+            sort(result.plus_terms.begin(),result.plus_terms.end());
+            auto last_1 = std::unique(result.minus_terms.begin(), result.minus_terms.end());
+            auto last_2 = std::unique(result.plus_terms.begin(), result.plus_terms.end());
+            result.minus_terms.erase(last_1,result.minus_terms.end());
+            result.plus_terms.erase(last_2,result.plus_terms.end());
     }
  
-    return result;
+    return parsed;
 }
  
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-        return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+optional<int> SearchServer::FindDocumentSlot(int document_id) const {
+        const auto it = document_slots_.find(document_id);
+        if (it == document_slots_.end()) {
+            return nullopt;
+        }
+        return it->second;
+}
+
+int SearchServer::GetDocumentSlot(int document_id) const {
+        if (const auto slot = FindDocumentSlot(document_id)) {
+            return *slot;
+        }
+        throw out_of_range("No document with id "s + to_string(document_id));
+}
+
+int SearchServer::AddDocumentSlot(int document_id) {
+        const int slot = static_cast<int>(slot_document_ids_.size());
+        document_slots_.emplace(document_id, slot);
+        slot_document_ids_.push_back(document_id);
+        return slot;
+}
+
+void SearchServer::EraseDocument(int document_id, int slot) {
+        document_slots_.erase(document_id);
+        forward_index_.Remove(slot);
+        documents_.Remove(slot);
+}
+
+size_t SearchServer::GetDocumentSlotBound() const {
+        return slot_document_ids_.size();
+}
+
+void SearchServer::ExcludeMinusWords(const Query& query, ScoreAccumulator& accumulator) const {
+        for (TermId term : query.minus_terms) {
+            const PostingList* postings = word_to_document_freqs_.Find(term);
+            if (postings == nullptr) {
+                continue;
+            }
+            postings->ForEach([&accumulator](int document_id, uint32_t) {
+                accumulator.Exclude(document_id);
+            });
+        }
+}
+
+SearchServer::QueryPostings SearchServer::GetQueryPostings(const Query& query) const {
+        QueryPostings query_postings;
+        for (TermId term : query.plus_terms) {
+            if (const PostingList* postings = word_to_document_freqs_.Find(term)) {
+                query_postings.plus.emplace_back(postings, ComputeWordInverseDocumentFreq(*postings));
+                query_postings.plus_posting_count += postings->size();
+            }
+        }
+        for (TermId term : query.minus_terms) {
+            if (const PostingList* postings = word_to_document_freqs_.Find(term)) {
+                query_postings.minus.push_back(postings);
+            }
+        }
+        return query_postings;
+}
+ 
+double SearchServer::ComputeWordInverseDocumentFreq(const PostingList& postings) const {
+        // log(N / df), with both logarithms maintained on updates
+        return log_document_count_ - postings.log_size();
+}
+
+void SearchServer::OnIndexChanged() {
+        ++generation_;
+        log_document_count_ = documents_.empty() ? 0.0 : log(static_cast<double>(documents_.size()));
 }
  
 void PrintDocument(const Document& document) {
@@ -264,9 +934,11 @@ void FindTopDocuments(const SearchServer& search_server, string_view raw_query)
 void MatchDocuments(const SearchServer& search_server, string_view query) {
     try {
         cout << "Матчинг документов по запросу: "s << query << endl;
-        for (auto i : search_server) {
-            const auto [words, status] = search_server.MatchDocument(query, i);
-            PrintMatchDocumentResult(i, words, status);
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        const auto results = search_server.MatchDocuments(execution::par, query, document_ids);
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            const auto& [words, status] = results[i];
+            PrintMatchDocumentResult(document_ids[i], words, status);
         }
     }
     catch (const invalid_argument& e) {
@@ -7,11 +7,29 @@
 #include <map>
 #include <cmath>
 #include <deque>
-#include "concurrent_map.h"
+#include "inverted_index.h"
+#include "term_dictionary.h"
+#include "memory_usage.h"
+#include "index_snapshot.h"
+#include "top_documents.h"
+#include "query_cache.h"
+#include "score_accumulator.h"
+#include "stop_word_set.h"
+#include "document_store.h"
+#include "forward_index.h"
+#include <iterator>
+#include <optional>
+#include <thread>
  
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-constexpr auto epsilon = 1e-6;
 using namespace std;
+
+namespace search_policy {
+// Sequential evaluation that skips documents which cannot reach the top
+// (MaxScore, named after the related WAND). Returns the same documents as execution::seq
+struct wand_policy {};
+inline constexpr wand_policy wand{};
+}
  
 class SearchServer {
 public:
@@ -31,6 +49,15 @@ public:
         : SearchServer(SplitIntoWords(stop_words_text)){}
  
     void AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings);
+
+    // Adds a batch of documents. Documents are tokenised in per-thread partial indexes,
+    // in parallel with execution::par, which are then merged into the index.
+    // Throws invalid_argument and adds nothing if any document is invalid
+    void AddDocuments(const vector<DocumentInput>& documents);
+
+    void AddDocuments(const execution::sequenced_policy&, const vector<DocumentInput>& documents);
+
+    void AddDocuments(const execution::parallel_policy&, const vector<DocumentInput>& documents);
     
     template <typename DocumentPredicate,typename Policy>
 vector<Document> FindTopDocuments(const Policy& policy,string_view raw_query, DocumentPredicate document_predicate) const;
@@ -47,40 +74,207 @@ vector<Document> FindTopDocuments(string_view raw_query, DocumentPredicate docum
     
     template<typename Policy>
     vector<Document> FindTopDocuments(const Policy& policy,string_view raw_query) const;
+
+    // Documents the filter admits are selected with bitmaps before scoring, no predicate
+    // is called per posting. Cached like the status overloads if the filter is a single status
+    template<typename Policy>
+    vector<Document> FindTopDocuments(const Policy& policy, string_view raw_query, const DocumentFilter& filter) const;
+
+    vector<Document> FindTopDocuments(string_view raw_query, const DocumentFilter& filter) const;
     
     
  
     int GetDocumentCount() const;
+
+    // How many documents FindTopDocuments returns, MAX_RESULT_DOCUMENT_COUNT by default
+    void SetMaxResultDocumentCount(size_t count);
+
+    size_t GetMaxResultDocumentCount() const;
+
+    // Results of FindTopDocuments by status are cached for up to capacity parsed queries;
+    // 0, the default, turns the cache off. Calls with a custom predicate are never cached
+    void SetQueryCacheCapacity(size_t capacity);
+
+    QueryCacheStats GetQueryCacheStats() const;
+
+    // FLOAT halves the memory scoring goes through and doubles the postings a vector
+    // kernel scores at once. Relevance then differs from DOUBLE by float rounding,
+    // about 1e-7 of its value, so documents closer than that may change places.
+    // search_policy::wand always scores in double
+    void SetScorePrecision(ScorePrecision precision);
+
+    ScorePrecision GetScorePrecision() const;
+
+    // Packs all posting lists into compressed blocks. Documents added later are
+    // buffered per list and sealed into blocks as they fill up; lists touched by
+    // RemoveDocument are unpacked, call again after such updates
+    void CompressIndex();
+
+    MemoryUsage GetMemoryUsage() const;
+
+    // Writes documents, dictionary and compressed posting lists to a binary snapshot.
+    // Throws runtime_error if the file cannot be written
+    void SaveIndex(const string& path) const;
+
+    // Maps a snapshot written by SaveIndex. Posting lists and words are used in place
+    // from the mapping, which is shared by all copies of the server. Loading reads
+    // the documents and the dictionary only: a posting list is checked the first time
+    // it is used, and the forward index, which would read them all, is only rebuilt
+    // if build_forward_index is true.
+    // Throws runtime_error if the file is missing, of another version or corrupted;
+    // queries and updates throw it too if they come across a corrupted posting list
+    static SearchServer LoadIndex(const string& path, bool build_forward_index = false);
+
+    // The forward index lists the words of every document for GetWordFrequencies,
+    // MatchDocument and RemoveDocument. Read-only deployments can drop it to save
+    // memory: MatchDocument then looks words up in the posting lists, while
+    // GetWordFrequencies and RemoveDocument have to search all of them, which is
+    // slow. Documents added without it are not recorded until it is rebuilt
+    void DropForwardIndex();
+
+    // Rebuilds the forward index from the posting lists
+    void BuildForwardIndex();
+
+    bool HasForwardIndex() const;
+ 
+    // Iterates over the ids of the documents in ascending order
+    class DocumentIdIterator {
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = int;
+        using difference_type = ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        explicit DocumentIdIterator(map<int, int>::const_iterator it)
+            : it_(it) {
+        }
+
+        reference operator*() const {
+            return it_->first;
+        }
+
+        pointer operator->() const {
+            return &it_->first;
+        }
+
+        DocumentIdIterator& operator++() {
+            ++it_;
+            return *this;
+        }
+
+        DocumentIdIterator operator++(int) {
+            return DocumentIdIterator(it_++);
+        }
+
+        bool operator==(const DocumentIdIterator& other) const {
+            return it_ == other.it_;
+        }
+
+        bool operator!=(const DocumentIdIterator& other) const {
+            return it_ != other.it_;
+        }
+
+    private:
+        map<int, int>::const_iterator it_;
+    };
+
+    DocumentIdIterator begin() const;
  
-    const std::set<int>::iterator begin() const;
- 
-    const std::set<int>::iterator end() const;
+    DocumentIdIterator end() const;
  
-    const std::map<string_view, double>& GetWordFrequencies(int document_id) const;
+    // Empty for an absent document
+    WordFrequencies GetWordFrequencies(int document_id) const;
  
     void RemoveDocument(int document_id);
  
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
  
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
+
+    // Removes many documents at once. They leave results, iteration and counts right away,
+    // while their postings are only marked as removed; CompactIndex drops them later.
+    // That also happens here once marked postings make up a quarter of the index.
+    // Ids of absent documents are ignored
+    void RemoveDocuments(const vector<int>& document_ids);
+
+    void RemoveDocuments(const execution::sequenced_policy&, const vector<int>& document_ids);
+
+    void RemoveDocuments(const execution::parallel_policy&, const vector<int>& document_ids);
+
+    // Drops the postings marked by RemoveDocuments and closes the gaps removed documents
+    // left in the slot numbering, so that memory follows the documents present rather
+    // than every document ever added. Rewrites every list that has a document after a gap
+    void CompactIndex();
+
+    void CompactIndex(const execution::sequenced_policy&);
+
+    void CompactIndex(const execution::parallel_policy&);
     
     tuple<vector<string_view>, DocumentStatus> MatchDocument(string_view raw_query, int document_id) const;
  
     tuple<vector<string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, string_view raw_query, int document_id) const; 
  
     tuple<vector<string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, string_view raw_query, int document_id) const;
+
+    // Matches the query, parsed once, against each of the documents, in parallel
+    // with execution::par. Element i is what MatchDocument returns for document_ids[i].
+    // Throws out_of_range if a document is absent
+    vector<tuple<vector<string_view>, DocumentStatus>> MatchDocuments(string_view raw_query, const vector<int>& document_ids) const;
+
+    vector<tuple<vector<string_view>, DocumentStatus>> MatchDocuments(const execution::sequenced_policy&, string_view raw_query, const vector<int>& document_ids) const;
+
+    vector<tuple<vector<string_view>, DocumentStatus>> MatchDocuments(const execution::parallel_policy&, string_view raw_query, const vector<int>& document_ids) const;
     
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-    };
-    const set<string,less<>> stop_words_;
-    map<string_view, map<int, double>> word_to_document_freqs_;
-    map<int, map<string_view, double>> document_id_word_freqs_;
-    map<int, DocumentData> documents_;
-    set<int> document_ids_;
-    deque<string> all_words;
+    const StopWordSet stop_words_;
+    TermDictionary dictionary_;
+    InvertedIndex word_to_document_freqs_;
+    // Inside the server documents are numbered by slots, given out densely in the
+    // order documents are added, so that postings, columns and accumulators are plain
+    // arrays. Removal leaves a gap until CompactIndex renumbers the slots, keeping
+    // their order. Ids only appear at the edges
+    map<int, int> document_slots_;
+    vector<int> slot_document_ids_;
+    ForwardIndex forward_index_;
+    bool has_forward_index_ = true;
+    DocumentStore documents_;
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+    ScorePrecision score_precision_ = ScorePrecision::DOUBLE;
+    mutable ScoreAccumulatorPool accumulators_;
+    mutable FloatScoreAccumulatorPool float_accumulators_;
+    mutable QueryCache query_cache_;
+    // Bumped by every change that can alter a query result
+    uint64_t generation_ = 0;
+    double log_document_count_ = 0.0;
+    // Snapshot the dictionary and posting lists point into, if loaded from one
+    shared_ptr<const index_snapshot::MappedFile> snapshot_;
+    // Documents removed by RemoveDocuments whose postings are still in the index, by slot
+    vector<bool> removed_documents_;
+    // Terms of those postings, one entry per posting
+    vector<TermId> removed_terms_;
+
+    bool IsRemoved(int slot) const {
+        return static_cast<size_t>(slot) < removed_documents_.size() && removed_documents_[slot];
+    }
+
+    optional<int> FindDocumentSlot(int document_id) const;
+
+    // Throws out_of_range if the document is absent
+    int GetDocumentSlot(int document_id) const;
+
+    // Gives out the next slot
+    int AddDocumentSlot(int document_id);
+
+    // Forgets the document; its postings are dealt with by the caller
+    void EraseDocument(int document_id, int slot);
+
+    // Calls f(term, term_count) for every term of the document, by ascending term
+    template <typename Function>
+    void ForEachDocumentTerm(int slot, Function f) const;
+
+    bool DocumentHasTerm(int slot, TermId term) const;
+
     bool IsStopWord(string_view word) const;
  
     static bool IsValidWord(string_view word);
@@ -88,6 +282,19 @@ private:
     vector<string_view> SplitIntoWordsNoStop(string_view text) const;
  
     static int ComputeAverageRating(const vector<int>& ratings);
+
+    template <typename Policy>
+    void AddDocumentBatch(const Policy& policy, const vector<DocumentInput>& documents);
+
+    template <typename Policy>
+    void RemoveDocumentBatch(const Policy& policy, const vector<int>& document_ids);
+
+    template <typename Policy>
+    void PurgeRemovedPostings(const Policy& policy);
+
+    // Numbers the documents present 0, 1, ... in slot order, purging marked postings on the way
+    template <typename Policy>
+    void RenumberSlots(const Policy& policy);
  
     struct QueryWord {
         string_view data;
@@ -95,26 +302,138 @@ private:
         bool is_stop;
     };
  
-    QueryWord ParseQueryWord(string_view text) const;
+    // is_valid tells whether the word is free of control characters
+    QueryWord ParseQueryWord(string_view text, bool is_valid) const;
  
     struct Query {
-        vector<string_view> plus_words;
-        vector<string_view> minus_words;
+        // Only words present in the dictionary, others cannot match anything
+        vector<TermId> plus_terms;
+        vector<TermId> minus_terms;
+    };
+
+    // Query taken from a per-thread free list and returned there when destroyed,
+    // so that a warmed-up thread parses queries without allocating
+    class ParsedQuery {
+    public:
+        ParsedQuery();
+        ParsedQuery(ParsedQuery&& other) = default;
+        ParsedQuery& operator=(ParsedQuery&& other) = delete;
+        ~ParsedQuery();
+
+        const Query& operator*() const {
+            return *query_;
+        }
+        const Query* operator->() const {
+            return query_.get();
+        }
+
+    private:
+        friend class SearchServer;
+        unique_ptr<Query> query_;
+
+        static vector<unique_ptr<Query>>& FreeQueries();
     };
  
-    Query ParseQuery(string_view text, const bool& flag) const;
+    ParsedQuery ParseQuery(string_view text, const bool& flag) const;
+
+    // Terms of a query to match. Plus terms are ordered by their words, so that
+    // matched words come out sorted
+    struct QueryTerms {
+        vector<TermId> plus_terms;
+        vector<TermId> minus_terms;
+    };
+
+    QueryTerms GetMatchTerms(const Query& query) const;
+
+    tuple<vector<string_view>, DocumentStatus> MatchQueryTerms(const QueryTerms& query_terms, int slot) const;
+
+    template <typename Policy>
+    vector<tuple<vector<string_view>, DocumentStatus>> MatchDocumentBatch(const Policy& policy, string_view raw_query, const vector<int>& document_ids) const;
+
+    template <typename DocumentPredicate, typename Policy>
+    vector<Document> FindTopDocuments(const Policy& policy, const Query& query, DocumentPredicate document_predicate) const;
+
+    // Stands in for a predicate: admits the documents whose bit is set and,
+    // if the bits do not account for it, whose rating is in the range.
+    // The bits cover every slot of the index
+    struct DocumentBitmap {
+        const uint64_t* bits;
+        int min_rating = INT_MIN;
+        int max_rating = INT_MAX;
+    };
+
+    // Per-thread buffer for the bitmap of a DocumentFilter
+    static vector<uint64_t>& SelectedDocuments();
+
+    // Whether a document whose postings are in the index may be returned
+    template <typename DocumentPredicate>
+    bool IsAdmitted(const DocumentPredicate& document_predicate, int slot) const {
+        return !IsRemoved(slot) && document_predicate(slot_document_ids_[slot], documents_.status(slot), documents_.rating(slot));
+    }
+
+    // Removed documents are cleared from the bitmaps. Branch free, as whether
+    // a document is admitted is as good as random
+    bool IsAdmitted(const DocumentBitmap& bitmap, int slot) const {
+        const bool selected = DocumentStore::TestBit(bitmap.bits, slot);
+        if (bitmap.min_rating == INT_MIN && bitmap.max_rating == INT_MAX) {
+            return selected;
+        }
+        const int rating = documents_.rating(slot);
+        return selected & (rating >= bitmap.min_rating) & (rating <= bitmap.max_rating);
+    }
  
+    // Scores every matching document and keeps the competitive ones in top_documents
     template <typename DocumentPredicate>
-    vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+    void FindAllDocuments(const Query& query, DocumentPredicate document_predicate, TopDocuments& top_documents) const;
     
     template <typename DocumentPredicate>
-    vector<Document> FindAllDocuments(execution::parallel_policy,const Query& query, DocumentPredicate document_predicate) const;
+    void FindAllDocuments(execution::parallel_policy,const Query& query, DocumentPredicate document_predicate, TopDocuments& top_documents) const;
     
         template <typename DocumentPredicate>
-        vector<Document> FindAllDocuments(execution::sequenced_policy,const Query& query, DocumentPredicate document_predicate) const;
+        void FindAllDocuments(execution::sequenced_policy,const Query& query, DocumentPredicate document_predicate, TopDocuments& top_documents) const;
+
+    template <typename DocumentPredicate>
+    void FindAllDocuments(search_policy::wand_policy, const Query& query, DocumentPredicate document_predicate, TopDocuments& top_documents) const;
+
+    // Type the policy scores in: WAND always uses double
+    template <typename Policy>
+    ScorePrecision GetScorePrecision(const Policy&) const {
+        return score_precision_;
+    }
+
+    ScorePrecision GetScorePrecision(search_policy::wand_policy) const {
+        return ScorePrecision::DOUBLE;
+    }
+
+    // Accumulators are indexed by slot, so they must cover every slot given out
+    size_t GetDocumentSlotBound() const;
+
+    // Posting lists of the words of a query, plus ones with their IDF
+    struct QueryPostings {
+        vector<pair<const PostingList*, double>> plus;
+        vector<const PostingList*> minus;
+        size_t plus_posting_count = 0;
+    };
+
+    QueryPostings GetQueryPostings(const Query& query) const;
+
+    // Scores the documents with slots in [first, last), in the precision of Score
+    template <typename Score, typename DocumentPredicate>
+    void ScoreDocuments(const QueryPostings& postings, int first, int last, DocumentPredicate document_predicate, TopDocuments& top_documents) const;
+
+    template <typename Score>
+    BasicScoreAccumulatorPool<Score>& GetAccumulators() const;
+
+    void ExcludeMinusWords(const Query& query, ScoreAccumulator& accumulator) const;
+
+    template <typename Score>
+    void CollectTopDocuments(const BasicScoreAccumulator<Score>& accumulator, TopDocuments& top_documents) const;
  
     // Existence required
-    double ComputeWordInverseDocumentFreq(string_view word) const;
+    double ComputeWordInverseDocumentFreq(const PostingList& postings) const;
+
+    // Invalidates cached results and refreshes the document count statistics
+    void OnIndexChanged();
  
 };
  
@@ -130,30 +449,31 @@ void FindTopDocuments(const SearchServer& search_server, string_view raw_query);
  
  template <typename DocumentPredicate,typename Policy>
 vector<Document> SearchServer::FindTopDocuments(const Policy& policy,string_view raw_query, DocumentPredicate document_predicate) const {
-        const auto query = ParseQuery(raw_query, true);
- 
-        auto matched_documents = FindAllDocuments(policy,query, document_predicate);
- 
-        sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-            if (abs(lhs.relevance - rhs.relevance) < epsilon) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
- 
-        return matched_documents;
+        return FindTopDocuments(policy, *ParseQuery(raw_query, true), document_predicate);
+}
+
+template <typename DocumentPredicate, typename Policy>
+vector<Document> SearchServer::FindTopDocuments(const Policy& policy, const Query& query, DocumentPredicate document_predicate) const {
+        TopDocuments top_documents(max_result_document_count_);
+        FindAllDocuments(policy,query, document_predicate, top_documents);
+        return top_documents.Extract();
 }
 
 template<typename Policy>
 vector<Document> SearchServer::FindTopDocuments(const Policy& policy,string_view raw_query, DocumentStatus status) const {
-        return FindTopDocuments(policy,raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+        const auto query = ParseQuery(raw_query, true);
+        const DocumentBitmap status_predicate{ documents_.status_bits(status).data() };
+        if (query_cache_.capacity() == 0) {
+            return FindTopDocuments(policy, *query, status_predicate);
+        }
+        // Policies share the entries as long as they score in the same type
+        const QueryCache::Key key{ query->plus_terms, query->minus_terms, status, GetScorePrecision(policy) };
+        if (auto cached = query_cache_.Find(key, generation_)) {
+            return move(*cached);
+        }
+        auto documents = FindTopDocuments(policy, *query, status_predicate);
+        query_cache_.Insert(key, generation_, documents);
+        return documents;
 }
 
 template<typename Policy>
@@ -161,74 +481,236 @@ vector<Document> SearchServer::FindTopDocuments(const Policy& policy,string_view
         return FindTopDocuments(policy,raw_query, DocumentStatus::ACTUAL);
 }
 
+template<typename Policy>
+vector<Document> SearchServer::FindTopDocuments(const Policy& policy, string_view raw_query, const DocumentFilter& filter) const {
+        if (filter.min_rating == INT_MIN && filter.max_rating == INT_MAX) {
+            for (size_t status = 0; status < DocumentStore::STATUS_COUNT; ++status) {
+                if (filter.status_mask == 1u << status) {
+                    return FindTopDocuments(policy, raw_query, static_cast<DocumentStatus>(status));
+                }
+            }
+        }
+        const auto query = ParseQuery(raw_query, true);
+        bool exact;
+        const vector<uint64_t>& selected = documents_.Select(filter, SelectedDocuments(), exact);
+        if (exact) {
+            return FindTopDocuments(policy, *query, DocumentBitmap{ selected.data() });
+        }
+        return FindTopDocuments(policy, *query, DocumentBitmap{ selected.data(), filter.min_rating, filter.max_rating });
+}
+
  template <typename DocumentPredicate>
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentPredicate document_predicate) const { 
     return FindTopDocuments(execution::seq, raw_query, document_predicate);
 }
 
 template <typename DocumentPredicate>
-vector<Document> SearchServer::FindAllDocuments(execution::sequenced_policy,const Query& query, DocumentPredicate document_predicate) const {
-        map<int, double> document_to_relevance;
-        for (auto word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
+void SearchServer::FindAllDocuments(execution::sequenced_policy,const Query& query, DocumentPredicate document_predicate, TopDocuments& top_documents) const {
+        const QueryPostings postings = GetQueryPostings(query);
+        const int slot_count = static_cast<int>(GetDocumentSlotBound());
+        if (score_precision_ == ScorePrecision::FLOAT) {
+            ScoreDocuments<float>(postings, 0, slot_count, document_predicate, top_documents);
+        } else {
+            ScoreDocuments<double>(postings, 0, slot_count, document_predicate, top_documents);
+        }
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate, TopDocuments& top_documents) const {
+FindAllDocuments(execution::seq,query, document_predicate, top_documents);
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindAllDocuments(execution::parallel_policy,const Query& query, DocumentPredicate document_predicate, TopDocuments& top_documents) const {
+        // The slot space is cut into ranges scored independently, each with its own
+        // accumulator and top, so even a one-word query uses every core.
+        // Only the small per-range tops are merged
+        const QueryPostings postings = GetQueryPostings(query);
+        const size_t posting_count = postings.plus_posting_count;
+        if (posting_count == 0) {
+            return;
+        }
+
+        // Below this a range costs more to schedule than to score
+        constexpr size_t MIN_RANGE_POSTINGS = 16384;
+        const size_t slot_count = GetDocumentSlotBound();
+        const size_t range_count = max<size_t>(1, min<size_t>({ posting_count / MIN_RANGE_POSTINGS, thread::hardware_concurrency(), slot_count }));
+        vector<TopDocuments> range_tops(range_count, TopDocuments(top_documents.capacity()));
+        for_each(execution::par, range_tops.begin(), range_tops.end(), [&](TopDocuments& range_top) {
+            const size_t range = &range_top - range_tops.data();
+            const int first = static_cast<int>(slot_count * range / range_count);
+            const int last = static_cast<int>(slot_count * (range + 1) / range_count);
+            if (score_precision_ == ScorePrecision::FLOAT) {
+                ScoreDocuments<float>(postings, first, last, document_predicate, range_top);
+            } else {
+                ScoreDocuments<double>(postings, first, last, document_predicate, range_top);
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        });
+
+        for (TopDocuments& range_top : range_tops) {
+            for (const Document& document : range_top.Extract()) {
+                if (top_documents.IsCompetitive(document.relevance)) {
+                    top_documents.Add(document);
                 }
             }
         }
- 
-        for (auto word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
-            }
+}
+
+template <typename Score, typename DocumentPredicate>
+void SearchServer::ScoreDocuments(const QueryPostings& postings, int first, int last, DocumentPredicate document_predicate, TopDocuments& top_documents) const {
+        auto accumulator = GetAccumulators<Score>().Acquire(last, first);
+        for (const PostingList* minus_postings : postings.minus) {
+            minus_postings->ForEachRun(first, last, [&accumulator](const int* slots, const uint32_t*, size_t count) {
+                for (size_t i = 0; i < count; ++i) {
+                    accumulator->Exclude(slots[i]);
+                }
+            });
         }
- 
-        vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance) {
-            matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+        const Score* inv_word_counts;
+        if constexpr (is_same_v<Score, float>) {
+            inv_word_counts = documents_.float_inv_word_counts().data();
+        } else {
+            inv_word_counts = documents_.inv_word_counts().data();
+        }
+        // Each run is narrowed to the admitted documents, then the accumulator's
+        // kernel scores it in one go
+        int slots[CompressedPostings::BLOCK_SIZE];
+        uint32_t term_counts[CompressedPostings::BLOCK_SIZE];
+        for (const auto& [plus_postings, inverse_document_freq] : postings.plus) {
+            plus_postings->ForEachRun(first, last, [&](const int* run_slots, const uint32_t* run_term_counts, size_t count) {
+                size_t admitted = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    const int slot = run_slots[i];
+                    slots[admitted] = slot;
+                    term_counts[admitted] = run_term_counts[i];
+                    admitted += IsAdmitted(document_predicate, slot);
+                }
+                accumulator->AddPostings(slots, term_counts, admitted, inv_word_counts, static_cast<Score>(inverse_document_freq));
+            });
         }
-        return matched_documents;
+        CollectTopDocuments(*accumulator, top_documents);
 }
 
-template <typename DocumentPredicate>
-vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-return FindAllDocuments(execution::seq,query, document_predicate);
+template <typename Score>
+BasicScoreAccumulatorPool<Score>& SearchServer::GetAccumulators() const {
+        if constexpr (is_same_v<Score, float>) {
+            return float_accumulators_;
+        } else {
+            return accumulators_;
+        }
 }
 
-template <typename DocumentPredicate>
-vector<Document> SearchServer::FindAllDocuments(execution::parallel_policy,const Query& query, DocumentPredicate document_predicate) const {
-        ConcurrentMap<int,double> mapa(documents_.size());
-        map<int, double> document_to_relevance;
-        for_each(execution::par,query.plus_words.begin(),query.plus_words.end(),[&](auto& word) {
-            if (word_to_document_freqs_.count(word) != 0) {
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    mapa[document_id].ref_to_value += term_freq * inverse_document_freq;
-                }
-            }
+template <typename Score>
+void SearchServer::CollectTopDocuments(const BasicScoreAccumulator<Score>& accumulator, TopDocuments& top_documents) const {
+        accumulator.ForEach([this, &top_documents](int slot, double relevance) {
+            if (top_documents.IsCompetitive(relevance)) {
+                top_documents.Add({ slot_document_ids_[slot], relevance, documents_.rating(slot) });
             }
         });
- 
-        for_each (execution::par,query.minus_words.begin(),query.minus_words.end(),[&](auto& word) {
-            if (word_to_document_freqs_.count(word) != 0) {
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                mapa.erase(document_id);
-            }}
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindAllDocuments(search_policy::wand_policy, const Query& query, DocumentPredicate document_predicate, TopDocuments& top_documents) const {
+        struct Term {
+            const PostingList* postings;
+            PostingList::Cursor cursor;
+            double inverse_document_freq;
+            // Largest contribution the word can make to any document
+            double upper_bound;
+        };
+        vector<Term> terms;
+        terms.reserve(query.plus_terms.size());
+        for (TermId term : query.plus_terms) {
+            const PostingList* postings = word_to_document_freqs_.Find(term);
+            if (postings == nullptr) {
+                continue;
+            }
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(*postings);
+            // Inflated a bit so that rounding in a real score never gets above the bound
+            const double upper_bound = postings->max_term_freq() * inverse_document_freq * (1.0 + 1e-9);
+            terms.push_back({ postings, PostingList::Cursor(*postings), inverse_document_freq, upper_bound });
+        }
+        auto accumulator = accumulators_.Acquire(GetDocumentSlotBound());
+        ExcludeMinusWords(query, *accumulator);
+
+        // MaxScore: with terms by ascending bound, the longest prefix whose bounds
+        // together cannot make the top is non-essential. Only documents of the other,
+        // essential terms are candidates; non-essential lists are merely probed for them.
+        // Slots are taken in windows, scored term at a time, and the split is redone
+        // for every window as the top fills up
+        vector<Term*> by_bound;
+        by_bound.reserve(terms.size());
+        for (Term& term : terms) {
+            by_bound.push_back(&term);
+        }
+        sort(by_bound.begin(), by_bound.end(), [](const Term* lhs, const Term* rhs) {
+            return lhs->upper_bound < rhs->upper_bound;
         });
-        vector<Document> matched_documents;
-        document_to_relevance = move(mapa.BuildOrdinaryMap());
-        for (const auto [document_id, relevance] : document_to_relevance) {
-            matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+        // Sums of the bounds of the first i terms
+        vector<double> bound_sums(by_bound.size() + 1, 0.0);
+        for (size_t i = 0; i < by_bound.size(); ++i) {
+            bound_sums[i + 1] = bound_sums[i] + by_bound[i]->upper_bound;
+        }
+
+        constexpr int WINDOW_SIZE = 4096;
+        vector<double> partial_scores(WINDOW_SIZE);
+        vector<uint64_t> candidates(WINDOW_SIZE / 64);
+        const int slot_count = static_cast<int>(GetDocumentSlotBound());
+        for (int first = 0; first < slot_count; first += WINDOW_SIZE) {
+            size_t non_essential = 0;
+            while (non_essential < by_bound.size() && !top_documents.IsCompetitive(bound_sums[non_essential + 1])) {
+                ++non_essential;
+            }
+            if (non_essential == by_bound.size()) {
+                break;
+            }
+            const int last = min(first + WINDOW_SIZE, slot_count);
+            for (size_t i = non_essential; i < by_bound.size(); ++i) {
+                const Term& term = *by_bound[i];
+                term.postings->ForEachRun(first, last, [&](const int* slots, const uint32_t* term_counts, size_t count) {
+                    for (size_t j = 0; j < count; ++j) {
+                        const int offset = slots[j] - first;
+                        partial_scores[offset] += term_counts[j] * documents_.inv_word_count(slots[j]) * term.inverse_document_freq;
+                        candidates[offset / 64] |= uint64_t{ 1 } << (offset % 64);
+                    }
+                });
+            }
+            for (size_t word = 0; word < candidates.size(); ++word) {
+                for (uint64_t bits = candidates[word]; bits != 0; bits &= bits - 1) {
+                    const int offset = static_cast<int>(word * 64) + __builtin_ctzll(bits);
+                    const int slot = first + offset;
+                    double bound = partial_scores[offset];
+                    partial_scores[offset] = 0.0;
+                    if (accumulator->IsExcluded(slot) || !IsAdmitted(document_predicate, slot)) {
+                        continue;
+                    }
+                    // Probed by descending bound until the document drops out. The partial
+                    // score is summed in another order than the real one, hence the slack
+                    size_t probed = non_essential;
+                    for (; probed > 0 && top_documents.IsCompetitive((bound + bound_sums[probed]) * (1.0 + 1e-9)); --probed) {
+                        PostingList::Cursor& cursor = by_bound[probed - 1]->cursor;
+                        cursor.SkipTo(slot);
+                        if (cursor.document_id() == slot) {
+                            bound += cursor.term_count() * documents_.inv_word_count(slot) * by_bound[probed - 1]->inverse_document_freq;
+                        }
+                    }
+                    if (probed > 0 || !top_documents.IsCompetitive(bound * (1.0 + 1e-9))) {
+                        continue;
+                    }
+                    // Summed in query order, like the exhaustive evaluation
+                    const double inv_word_count = documents_.inv_word_count(slot);
+                    double relevance = 0.0;
+                    for (Term& term : terms) {
+                        term.cursor.SkipTo(slot);
+                        if (term.cursor.document_id() == slot) {
+                            relevance += term.cursor.term_count() * inv_word_count * term.inverse_document_freq;
+                        }
+                    }
+                    if (top_documents.IsCompetitive(relevance)) {
+                        top_documents.Add({ slot_document_ids_[slot], relevance, documents_.rating(slot) });
+                    }
+                }
+                candidates[word] = 0;
+            }
         }
-        return matched_documents;
-}
\ No newline at end of file
+}
@@ -0,0 +1,91 @@
+#include "stop_word_set.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// A bucket whose words find no free slots after this many displacements
+// makes the table grow
+constexpr uint64_t MAX_DISPLACEMENT = 1 << 16;
+}
+
+StopWordSet::StopWordSet(const std::set<std::string, std::less<>>& words)
+    : words_(words.begin(), words.end()) {
+    for (const std::string& word : words_) {
+        if (!word.empty()) {
+            SetBit(length_mask_, word.size());
+            SetBit(first_chars_, static_cast<unsigned char>(word[0]));
+        }
+    }
+    size_t slot_count = 1;
+    while (slot_count < words_.size() * 2) {
+        slot_count *= 2;
+    }
+    while (!Build(slot_count)) {
+        slot_count *= 2;
+    }
+}
+
+bool StopWordSet::Build(size_t slot_count) {
+    // About four words per bucket
+    displacements_.assign(std::max<size_t>(1, words_.size() / 4), 0);
+    slots_.assign(slot_count, EMPTY_SLOT);
+    slot_mask_ = slot_count - 1;
+
+    std::vector<uint64_t> hashes(words_.size());
+    std::vector<std::vector<uint32_t>> buckets(displacements_.size());
+    for (uint32_t index = 0; index < words_.size(); ++index) {
+        hashes[index] = Hash(words_[index]);
+        buckets[(hashes[index] >> 32) % buckets.size()].push_back(index);
+    }
+    std::vector<size_t> order(buckets.size());
+    for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+        order[bucket] = bucket;
+    }
+    // Large buckets are placed while the table is still empty
+    std::stable_sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    std::vector<size_t> taken;
+    for (size_t bucket : order) {
+        bool placed = buckets[bucket].empty();
+        for (uint64_t displacement = 0; !placed && displacement < MAX_DISPLACEMENT; ++displacement) {
+            taken.clear();
+            placed = true;
+            for (uint32_t index : buckets[bucket]) {
+                const size_t slot = Mix(hashes[index] ^ displacement) & slot_mask_;
+                if (slots_[slot] != EMPTY_SLOT) {
+                    placed = false;
+                    break;
+                }
+                slots_[slot] = index;
+                taken.push_back(slot);
+            }
+            if (placed) {
+                displacements_[bucket] = displacement;
+            } else {
+                for (size_t slot : taken) {
+                    slots_[slot] = EMPTY_SLOT;
+                }
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t StopWordSet::Hash(std::string_view word) {
+    // FNV-1a over 8-byte words
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= word.size(); i += sizeof(uint64_t)) {
+        uint64_t chunk;
+        std::memcpy(&chunk, word.data() + i, sizeof(chunk));
+        hash = (hash ^ chunk) * 1099511628211ull;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, word.data() + i, word.size() - i);
+    return Mix((hash ^ tail ^ word.size()) * 1099511628211ull);
+}
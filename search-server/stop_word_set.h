@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable set of stop words, fixed at construction.
+// A lookup first tests the word's length and first character against bitmasks,
+// which turns away most ordinary words without hashing, and then probes a
+// perfect hash table (hash and displace) with a single comparison
+class StopWordSet {
+public:
+    StopWordSet() = default;
+
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+
+    bool Contains(std::string_view word) const {
+        if (word.empty() || !TestBit(length_mask_, word.size()) || !TestBit(first_chars_, static_cast<unsigned char>(word[0]))) {
+            return false;
+        }
+        const uint64_t hash = Hash(word);
+        const uint32_t slot = slots_[Mix(hash ^ displacements_[(hash >> 32) % displacements_.size()]) & slot_mask_];
+        return slot != EMPTY_SLOT && words_[slot] == word;
+    }
+
+    // Words in ascending order
+    std::vector<std::string>::const_iterator begin() const {
+        return words_.begin();
+    }
+
+    std::vector<std::string>::const_iterator end() const {
+        return words_.end();
+    }
+
+    size_t size() const {
+        return words_.size();
+    }
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+    static constexpr size_t MASK_BITS = 256;
+
+    std::vector<std::string> words_;
+    // Bit min(length, 255) is set for every word length
+    uint64_t length_mask_[MASK_BITS / 64] = {};
+    // Bit c is set for every first character c
+    uint64_t first_chars_[MASK_BITS / 64] = {};
+    // Words are grouped into buckets by hash; every bucket has a displacement
+    // that sends its words to slots no other word uses
+    std::vector<uint64_t> displacements_ = { 0 };
+    // Indexes into words_
+    std::vector<uint32_t> slots_ = { EMPTY_SLOT };
+    size_t slot_mask_ = 0;
+
+    static bool TestBit(const uint64_t (&mask)[MASK_BITS / 64], size_t bit) {
+        bit = bit < MASK_BITS ? bit : MASK_BITS - 1;
+        return (mask[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    static void SetBit(uint64_t (&mask)[MASK_BITS / 64], size_t bit) {
+        bit = bit < MASK_BITS ? bit : MASK_BITS - 1;
+        mask[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+
+    static uint64_t Hash(std::string_view word);
+
+    // splitmix64 finalizer
+    static uint64_t Mix(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    bool Build(size_t slot_count);
+};
@@ -1,19 +1,44 @@
 #include "string_processing.h"
- 
- 
-std::vector<std::string_view> SplitIntoWords( std::string_view text) {
-    std::vector<std::string_view> words;
-    size_t pos = 0;
-    size_t end = text.npos;
-    while(true) {
-        size_t space = text.find(' ', pos);
-        words.push_back(space == end ? text.substr(pos) : text.substr(pos, space - pos));
-        if (space == end ) {
-            break;
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Spaces end a word, other characters in [0, ' ') make it invalid
+bool IsWordDelimiter(char c) {
+    return c >= '\0' && c <= ' ';
+}
+}
+
+size_t FindWordDelimiter(std::string_view text, size_t pos) {
+    const char* data = text.data();
+    const size_t size = text.size();
+#if defined(__SSE2__)
+    const __m128i below = _mm_set1_epi8(' ' + 1);
+    const __m128i negative = _mm_set1_epi8(-1);
+    for (; pos + 16 <= size; pos += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        // Signed compares: bytes >= 0x80 are negative and never delimiters
+        const __m128i delimiters = _mm_and_si128(_mm_cmpgt_epi8(chunk, negative), _mm_cmplt_epi8(chunk, below));
+        const int mask = _mm_movemask_epi8(delimiters);
+        if (mask != 0) {
+            return pos + __builtin_ctz(static_cast<unsigned>(mask));
         }
-        else {
-            pos = space + 1;
+    }
+#endif
+    for (; pos < size; ++pos) {
+        if (IsWordDelimiter(data[pos])) {
+            return pos;
         }
     }
+    return size;
+}
+
+std::vector<std::string_view> SplitIntoWords(std::string_view text) {
+    std::vector<std::string_view> words;
+    ForEachWord(text, [&words](std::string_view word, bool) {
+        words.push_back(word);
+    });
     return words;
-}
\ No newline at end of file
+}
@@ -1,8 +1,38 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <set>
 #include <vector>
 #include <functional>
+
+// Position of the first space or control character in text at or after pos,
+// text.size() if there is none. Scans 16 bytes at a time where SSE2 is available
+size_t FindWordDelimiter(std::string_view text, size_t pos);
+
+// Calls f(word, is_valid) for every word of text in a single pass without allocating.
+// Words are separated by runs of spaces, so leading, trailing and repeated spaces
+// produce no empty words. is_valid is false if the word contains a control character
+template <typename Function>
+void ForEachWord(std::string_view text, Function f) {
+    size_t pos = 0;
+    while (true) {
+        while (pos < text.size() && text[pos] == ' ') {
+            ++pos;
+        }
+        if (pos == text.size()) {
+            return;
+        }
+        const size_t first = pos;
+        bool is_valid = true;
+        pos = FindWordDelimiter(text, pos);
+        while (pos < text.size() && text[pos] != ' ') {
+            is_valid = false;
+            pos = FindWordDelimiter(text, pos + 1);
+        }
+        f(text.substr(first, pos - first), is_valid);
+    }
+}
+
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
  
 template <typename StringContainer>
@@ -14,4 +44,4 @@ std::set<std::string,std::less<>> MakeUniqueNonEmptyStrings(const StringContaine
         }
     }
     return non_empty_strings;
-}
\ No newline at end of file
+}
@@ -0,0 +1,59 @@
+#include "term_dictionary.h"
+
+TermDictionary::TermDictionary(const TermDictionary& other) {
+    *this = other;
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this == &other) {
+        return *this;
+    }
+    words_.clear();
+    words_by_id_.clear();
+    ids_.clear();
+    for (std::string_view word : other.words_by_id_) {
+        Intern(word);
+    }
+    return *this;
+}
+
+TermId TermDictionary::Intern(std::string_view word) {
+    if (auto it = ids_.find(word); it != ids_.end()) {
+        return it->second;
+    }
+    const TermId term = static_cast<TermId>(words_by_id_.size());
+    std::string_view stored = words_.emplace_back(word);
+    words_by_id_.push_back(stored);
+    ids_.emplace(stored, term);
+    return term;
+}
+
+TermId TermDictionary::InternExternal(std::string_view word) {
+    if (auto it = ids_.find(word); it != ids_.end()) {
+        return it->second;
+    }
+    const TermId term = static_cast<TermId>(words_by_id_.size());
+    words_by_id_.push_back(word);
+    ids_.emplace(word, term);
+    return term;
+}
+
+std::optional<TermId> TermDictionary::Find(std::string_view word) const {
+    if (auto it = ids_.find(word); it != ids_.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+size_t TermDictionary::memory_usage() const {
+    size_t bytes = words_by_id_.capacity() * sizeof(std::string_view) + ids_.bucket_count() * sizeof(void*);
+    // A hash node holds the pair, a next pointer and the cached hash
+    bytes += ids_.size() * (sizeof(std::pair<const std::string_view, TermId>) + 2 * sizeof(void*));
+    for (const std::string& word : words_) {
+        bytes += sizeof(std::string);
+        if (word.capacity() > std::string().capacity()) {
+            bytes += word.capacity() + 1;
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using TermId = uint32_t;
+
+// Stores every distinct word once and numbers them densely from zero.
+// Views returned by GetWord stay valid for the dictionary's lifetime
+class TermDictionary {
+public:
+    TermDictionary() = default;
+
+    // Views point into words_, so a copy has to rebuild them
+    TermDictionary(const TermDictionary& other);
+    TermDictionary& operator=(const TermDictionary& other);
+    // Moving a deque keeps its elements in place
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    // Id of the word, assigned on first sight
+    TermId Intern(std::string_view word);
+
+    // Like Intern, but keeps a view of the word instead of a copy; the caller
+    // keeps the characters alive for the dictionary's lifetime
+    TermId InternExternal(std::string_view word);
+
+    // Id of the word if it was ever interned
+    std::optional<TermId> Find(std::string_view word) const;
+
+    std::string_view GetWord(TermId term) const {
+        return words_by_id_[term];
+    }
+
+    size_t size() const {
+        return words_by_id_.size();
+    }
+
+    size_t memory_usage() const;
+
+private:
+    // Words not added by InternExternal
+    std::deque<std::string> words_;
+    std::vector<std::string_view> words_by_id_;
+    std::unordered_map<std::string_view, TermId> ids_;
+};
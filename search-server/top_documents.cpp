@@ -0,0 +1,43 @@
+#include "top_documents.h"
+#include <algorithm>
+#include <cmath>
+
+TopDocuments::TopDocuments(size_t capacity)
+    : capacity_(capacity) {
+}
+
+bool TopDocuments::IsBetter(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < epsilon) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+bool TopDocuments::IsCompetitive(double relevance) const {
+    if (heap_.size() < capacity_) {
+        return capacity_ > 0;
+    }
+    return relevance > heap_.front().relevance - epsilon;
+}
+
+void TopDocuments::Add(const Document& document) {
+    if (heap_.size() < capacity_) {
+        heap_.push_back(document);
+        std::push_heap(heap_.begin(), heap_.end(), IsBetter);
+        return;
+    }
+    if (capacity_ == 0 || !IsBetter(document, heap_.front())) {
+        return;
+    }
+    std::pop_heap(heap_.begin(), heap_.end(), IsBetter);
+    heap_.back() = document;
+    std::push_heap(heap_.begin(), heap_.end(), IsBetter);
+}
+
+std::vector<Document> TopDocuments::Extract() {
+    std::sort_heap(heap_.begin(), heap_.end(), IsBetter);
+    return std::move(heap_);
+}
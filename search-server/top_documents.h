@@ -0,0 +1,33 @@
+#pragma once
+#include "document.h"
+#include <vector>
+
+// Keeps the best `capacity` documents seen so far: by relevance (within epsilon),
+// then by rating, then by lower id. Costs O(log capacity) per accepted document
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t capacity);
+
+    // Cheap pre-check: false if a document with this relevance can never get in
+    bool IsCompetitive(double relevance) const;
+
+    void Add(const Document& document);
+
+    size_t size() const {
+        return heap_.size();
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    // Best first. Leaves the collector empty
+    std::vector<Document> Extract();
+
+    static bool IsBetter(const Document& lhs, const Document& rhs);
+
+private:
+    size_t capacity_;
+    // Heap with the worst kept document on top
+    std::vector<Document> heap_;
+};